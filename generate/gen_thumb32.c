@@ -28,12 +28,18 @@
 typedef enum {
   nothing,
   one_reg_any_imm12,
+  one_reg_any_imm12_sf,
+  one_reg_any_imm16,
+  one_reg_any_const32_sf,
   one_reg_any_registerlist,
   two_regs_any_imm12,
   two_regs_any_imm12_sf,
+  two_regs_any_const32_sf,
   two_regs_any_imm5_sf,
   two_regs_any_imm5_shift,
   two_regs_any_imm5_shift_sf,
+  rn_any_imm12,
+  rn_any_const32,
   three_regs_any,
   three_regs_any_sf,
   three_regs_any_imm5_shift_sf,
@@ -53,7 +59,7 @@ const thumb32_opcode opcodes[] =
   { {"m0_dsb"        , 0b11110011101111111000111101001111, nothing},
     {"m0_dmb"        , 0b11110011101111111000111101011111, nothing},
     {"m0_isb"        , 0b11110011101111111000111101101111, nothing},
-    {"m0_bl"         , 0b11110000000000001100000000000000, branch},
+    {"m0_bl"         , 0b11110000000000001101000000000000, branch},
     {"m3_adc_imm"    , 0b11110001010000000000000000000000, two_regs_any_imm12_sf},
     {"m3_adc_any"    , 0b11101011010000000000000000000000, three_regs_any_imm5_shift_sf},
     {"m3_add_const"  , 0b11110001000000000000000000000000, two_regs_any_imm12_sf},
@@ -83,12 +89,12 @@ const thumb32_opcode opcodes[] =
     {"m3_bal"        , 0b11110011110000001000000000000000, cond_branch},
     {"m3_b"          , 0b11110000000000001001000000000000, branch},
     {"m3_bic_imm"    , 0b11110000001000000000000000000000, two_regs_any_imm12_sf},
-    {"m3_bic_any"    , 0b11101000100000000000000000000000, three_regs_any_imm5_shift_sf},
+    {"m3_bic_any"    , 0b11101010001000000000000000000000, three_regs_any_imm5_shift_sf},
     {"m3_clrex"      , 0b11110011101111111000111100101111, nothing},
     {"m3_clz"        , 0b11111010101100001111000010000000, three_regs_any},
-    {"m3_cmn_imm"    , 0b11110001000100000000111100000000, one_reg_any_imm12},
+    {"m3_cmn_imm"    , 0b11110001000100000000111100000000, rn_any_imm12},
     {"m3_cmn_any"    , 0b11101011000100000000111100000000, two_regs_any_imm5_shift},
-    {"m3_cmp_imm"    , 0b11110001101100000000111100000000, one_reg_any_imm12},
+    {"m3_cmp_imm"    , 0b11110001101100000000111100000000, rn_any_imm12},
     {"m3_cmp_any"    , 0b11101011101100000000111100000000, two_regs_any_imm5_shift},
     {"m3_csdb"       , 0b11110011101011111000000000010100, nothing},
     {"m3_eor_imm"    , 0b11110000100000000000000000000000, two_regs_any_imm12_sf},
@@ -98,6 +104,34 @@ const thumb32_opcode opcodes[] =
     {"m3_ldmdb"      , 0b11101001000100000000000000000000, one_reg_any_registerlist},
     {"m3_ldmdbw"     , 0b11101001001100000000000000000000, one_reg_any_registerlist},
     {"m3_ldr_imm"    , 0b11111000110100000000000000000000, two_regs_any_imm12},
+    {"m3_mov_imm"    , 0b11110000010011110000000000000000, one_reg_any_imm12_sf},
+    {"m3_movw"       , 0b11110010010000000000000000000000, one_reg_any_imm16},
+    {"m3_movt"       , 0b11110010110000000000000000000000, one_reg_any_imm16},
+    {"m3_mvn_imm"    , 0b11110000011011110000000000000000, one_reg_any_imm12_sf},
+    {"m3_orn_imm"    , 0b11110000011000000000000000000000, two_regs_any_imm12_sf},
+    {"m3_orr_imm"    , 0b11110000010000000000000000000000, two_regs_any_imm12_sf},
+    {"m3_rsb_imm"    , 0b11110001110000000000000000000000, two_regs_any_imm12_sf},
+    {"m3_sbc_imm"    , 0b11110001011000000000000000000000, two_regs_any_imm12_sf},
+    {"m3_sub_const"  , 0b11110001101000000000000000000000, two_regs_any_imm12_sf},
+    {"m3_teq_imm"    , 0b11110000100100000000111100000000, rn_any_imm12},
+    {"m3_tst_imm"    , 0b11110000000100000000111100000000, rn_any_imm12},
+    /* The same with a 32bit constant, encoded as a modified immediate */
+    {"m3_adc_const32", 0b11110001010000000000000000000000, two_regs_any_const32_sf},
+    {"m3_add_const32", 0b11110001000000000000000000000000, two_regs_any_const32_sf},
+    {"m3_and_const32", 0b11110000000000000000000000000000, two_regs_any_const32_sf},
+    {"m3_bic_const32", 0b11110000001000000000000000000000, two_regs_any_const32_sf},
+    {"m3_cmn_const32", 0b11110001000100000000111100000000, rn_any_const32},
+    {"m3_cmp_const32", 0b11110001101100000000111100000000, rn_any_const32},
+    {"m3_eor_const32", 0b11110000100000000000000000000000, two_regs_any_const32_sf},
+    {"m3_mov_const32", 0b11110000010011110000000000000000, one_reg_any_const32_sf},
+    {"m3_mvn_const32", 0b11110000011011110000000000000000, one_reg_any_const32_sf},
+    {"m3_orn_const32", 0b11110000011000000000000000000000, two_regs_any_const32_sf},
+    {"m3_orr_const32", 0b11110000010000000000000000000000, two_regs_any_const32_sf},
+    {"m3_rsb_const32", 0b11110001110000000000000000000000, two_regs_any_const32_sf},
+    {"m3_sbc_const32", 0b11110001011000000000000000000000, two_regs_any_const32_sf},
+    {"m3_sub_const32", 0b11110001101000000000000000000000, two_regs_any_const32_sf},
+    {"m3_teq_const32", 0b11110000100100000000111100000000, rn_any_const32},
+    {"m3_tst_const32", 0b11110000000100000000111100000000, rn_any_const32},
     {NULL, 0, 0}};
 
 /* left out for now, 
@@ -114,6 +148,15 @@ void print_extern_decl(thumb32_opcode op) {
   case one_reg_any_imm12:
     printf("extern thumb_opcode_t %s(reg_t rd, uint16_t imm12);\n", op.name);
     break;
+  case one_reg_any_imm12_sf:
+    printf("extern thumb_opcode_t %s(reg_t rd, uint16_t imm12, bool sf);\n", op.name);
+    break;
+  case one_reg_any_imm16:
+    printf("extern thumb_opcode_t %s(reg_t rd, uint16_t imm16);\n", op.name);
+    break;
+  case one_reg_any_const32_sf:
+    printf("extern thumb_opcode_t %s(reg_t rd, uint32_t value, bool sf);\n", op.name);
+    break;
   case one_reg_any_registerlist:
     printf("extern thumb_opcode_t %s(reg_t rn, uint16_t rl);\n", op.name);
     break;
@@ -123,11 +166,20 @@ void print_extern_decl(thumb32_opcode op) {
   case two_regs_any_imm12_sf:
     printf("extern thumb_opcode_t %s(reg_t rd, reg_t rn, uint16_t imm12, bool sf);\n", op.name);
     break;
+  case two_regs_any_const32_sf:
+    printf("extern thumb_opcode_t %s(reg_t rd, reg_t rn, uint32_t value, bool sf);\n", op.name);
+    break;
+  case rn_any_imm12:
+    printf("extern thumb_opcode_t %s(reg_t rn, uint16_t imm12);\n", op.name);
+    break;
+  case rn_any_const32:
+    printf("extern thumb_opcode_t %s(reg_t rn, uint32_t value);\n", op.name);
+    break;
   case two_regs_any_imm5_sf:
     printf("extern thumb_opcode_t %s(reg_t rd, reg_t rn, uint8_t imm5, bool sf);\n", op.name);
     break;
   case two_regs_any_imm5_shift:
-    printf("extern thumb_opcode_t %s(reg_t rd, reg_t rn, uint8_t imm5, imm_shift_t shift);\n", op.name);
+    printf("extern thumb_opcode_t %s(reg_t rn, reg_t rm, uint8_t imm5, imm_shift_t shift);\n", op.name);
     break;
   case two_regs_any_imm5_shift_sf:
     printf("extern thumb_opcode_t %s(reg_t rd, reg_t rn, uint8_t imm5, imm_shift_t shift, bool sf);\n", op.name);
@@ -166,9 +218,24 @@ void print_opcode(thumb32_opcode op) {
     printf("  return thumb32_opcode_one_reg_any_imm12(%u, rd, imm12);\n", op.opcode);
     printf("}\n\n");
     break;
+  case one_reg_any_imm12_sf:
+    printf("thumb_opcode_t %s(reg_t rd, uint16_t imm12, bool sf) {\n", op.name);
+    printf("  return thumb32_opcode_one_reg_any_imm12_sf(%u, rd, imm12, sf);\n", op.opcode);
+    printf("}\n\n");
+    break;
+  case one_reg_any_imm16:
+    printf("thumb_opcode_t %s(reg_t rd, uint16_t imm16) {\n", op.name);
+    printf("  return thumb32_opcode_one_reg_any_imm16(%u, rd, imm16);\n", op.opcode);
+    printf("}\n\n");
+    break;
+  case one_reg_any_const32_sf:
+    printf("thumb_opcode_t %s(reg_t rd, uint32_t value, bool sf) {\n", op.name);
+    printf("  return thumb32_opcode_one_reg_any_const32_sf(%u, rd, value, sf);\n", op.opcode);
+    printf("}\n\n");
+    break;
   case one_reg_any_registerlist:
     printf("thumb_opcode_t %s(reg_t rn, uint16_t rl) {\n", op.name);
-    printf("  return thump32_opcode_one_reg_any_registerlist(%u, rn, rl);\n", op.opcode);
+    printf("  return thumb32_opcode_one_reg_any_registerlist(%u, rn, rl);\n", op.opcode);
     printf("}\n\n");
     break;
   case two_regs_any_imm12:
@@ -181,14 +248,29 @@ void print_opcode(thumb32_opcode op) {
     printf("  return thumb32_opcode_two_regs_any_imm12_sf(%u, rd, rn, imm12, sf);\n", op.opcode);
     printf("}\n\n");
     break;
+  case two_regs_any_const32_sf:
+    printf("thumb_opcode_t %s(reg_t rd, reg_t rn, uint32_t value, bool sf) {\n", op.name);
+    printf("  return thumb32_opcode_two_regs_any_const32_sf(%u, rd, rn, value, sf);\n", op.opcode);
+    printf("}\n\n");
+    break;
+  case rn_any_imm12:
+    printf("thumb_opcode_t %s(reg_t rn, uint16_t imm12) {\n", op.name);
+    printf("  return thumb32_opcode_rn_any_imm12(%u, rn, imm12);\n", op.opcode);
+    printf("}\n\n");
+    break;
+  case rn_any_const32:
+    printf("thumb_opcode_t %s(reg_t rn, uint32_t value) {\n", op.name);
+    printf("  return thumb32_opcode_rn_any_const32(%u, rn, value);\n", op.opcode);
+    printf("}\n\n");
+    break;
   case two_regs_any_imm5_sf:
     printf("thumb_opcode_t %s(reg_t rd, reg_t rn, uint8_t imm5, bool sf) {\n", op.name);
     printf("  return thumb32_opcode_two_regs_any_imm5_sf(%u, rd, rn, imm5, sf);\n", op.opcode);
     printf("}\n\n");
     break;
   case two_regs_any_imm5_shift:
-    printf("thumb_opcode_t %s(reg_t rd, reg_t rn, uint8_t imm5, imm_shift_t shift) {\n", op.name);
-    printf("  return thumb32_opcode_two_regs_any_imm5_shift(%u, rd, rn, imm5, shift);\n", op.opcode);
+    printf("thumb_opcode_t %s(reg_t rn, reg_t rm, uint8_t imm5, imm_shift_t shift) {\n", op.name);
+    printf("  return thumb32_opcode_two_regs_any_imm5_shift(%u, rn, rm, imm5, shift);\n", op.opcode);
     printf("}\n\n");
     break;
   case two_regs_any_imm5_shift_sf:
@@ -235,7 +317,9 @@ void unique_ops() {
   while (opcodes[i].name) {
     int j = i+1;
     while (opcodes[j].name) {
-      if (i != j && opcodes[i].opcode == opcodes[j].opcode) {
+      /* the const32 entries share opcodes with the imm12 ones */
+      if (i != j && opcodes[i].opcode == opcodes[j].opcode &&
+	  opcodes[i].format == opcodes[j].format) {
 	printf("WARNING!\n");
 	printf("opcodes at indices %d and %d are the same\n", i, j);
 	printf("%d: %s :  %u \n", i, opcodes[i].name, opcodes[i].opcode);
@@ -0,0 +1,74 @@
+/**********************************************************************************/
+/* MIT License									  */
+/* 										  */
+/* Copyright (c) 2020 Joel Svensson             				  */
+/* 										  */
+/* Permission is hereby granted, free of charge, to any person obtaining a copy	  */
+/* of this software and associated documentation files (the "Software"), to deal  */
+/* in the Software without restriction, including without limitation the rights	  */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell	  */
+/* copies of the Software, and to permit persons to whom the Software is	  */
+/* furnished to do so, subject to the following conditions:			  */
+/* 										  */
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software.				  */
+/* 										  */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR	  */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,	  */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE	  */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER	  */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,  */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE  */
+/* SOFTWARE.									  */
+/**********************************************************************************/
+
+#ifndef __CONSTANTS_H_
+#define __CONSTANTS_H_
+
+#include <thumb.h>
+
+/*
+   Putting a 32bit constant in a register.
+
+   load_constant picks the cheapest of
+     M0 and up:  MOVS, MOVS+MVNS, MOVS+LSLS, MOVS+ADDS,
+                 MOVS+LSLS+ADDS, MOVS+LSLS+MVNS, LDR from the literal pool
+     M3 and up:  MOV.W / MVN.W with a modified immediate, MOVW, MOVW+MOVT
+   by code size or by cycles. The 16bit forms set the flags, so the
+   flags should be considered clobbered.
+*/
+
+typedef enum {
+  const_min_bytes,
+  const_min_cycles
+} const_policy_t;
+
+typedef enum {
+  const_none,
+  const_movs,            /* MOVS rd, #a */
+  const_movs_mvns,       /* MOVS rd, #a; MVNS rd, rd */
+  const_movs_lsls,       /* MOVS rd, #a; LSLS rd, rd, #b */
+  const_movs_adds,       /* MOVS rd, #a; ADDS rd, #b */
+  const_movs_lsls_adds,  /* MOVS rd, #a; LSLS rd, rd, #b; ADDS rd, #c */
+  const_movs_lsls_mvns,  /* MOVS rd, #a; LSLS rd, rd, #b; MVNS rd, rd */
+  const_mov_w,           /* MOV.W rd, #a (a is the encoded imm12) */
+  const_mvn_w,           /* MVN.W rd, #a (a is the encoded imm12) */
+  const_movw,            /* MOVW rd, #a */
+  const_movw_movt,       /* MOVW rd, #a; MOVT rd, #b */
+  const_literal          /* LDR rd, [PC, #..] from the literal pool */
+} const_strategy_t;
+
+typedef struct {
+  const_strategy_t strategy;
+  unsigned int bytes;  /* including the pool entry if it is new */
+  unsigned int cycles;
+  uint32_t a, b, c;
+} const_plan_t;
+
+extern bool const_plan(instr_seq_t *seq, reg_t rd, uint32_t value,
+		       target_t target, const_policy_t policy, const_plan_t *plan);
+extern int const_emit(instr_seq_t *seq, reg_t rd, const_plan_t *plan);
+extern int load_constant(instr_seq_t *seq, reg_t rd, uint32_t value,
+			 target_t target, const_policy_t policy);
+
+#endif
@@ -0,0 +1,81 @@
+/**********************************************************************************/
+/* MIT License									  */
+/* 										  */
+/* Copyright (c) 2020 Joel Svensson             				  */
+/* 										  */
+/* Permission is hereby granted, free of charge, to any person obtaining a copy	  */
+/* of this software and associated documentation files (the "Software"), to deal  */
+/* in the Software without restriction, including without limitation the rights	  */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell	  */
+/* copies of the Software, and to permit persons to whom the Software is	  */
+/* furnished to do so, subject to the following conditions:			  */
+/* 										  */
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software.				  */
+/* 										  */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR	  */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,	  */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE	  */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER	  */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,  */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE  */
+/* SOFTWARE.									  */
+/**********************************************************************************/
+
+#ifndef __COST_H_
+#define __COST_H_
+
+#include <thumb.h>
+#include <decode.h>
+
+/*
+   Cycle cost model for Cortex-M0, M0+, M3 and M4.
+
+   Costs are per decoded instruction class and core, from the
+   instruction timing tables of the technical reference manuals, so
+   they apply to the output of every m0_ and m3_ encoder as well as to
+   emitted sequences. Where the timing depends on the data (long
+   multiplies, divides) the worst case is used.
+
+   On top of the table the model adds
+     - the pipeline refill of taken branches and writes to the PC
+       (2 cycles on M0, M3 and M4, 1 on M0+),
+     - one cycle per register of LDM/STM/PUSH/POP,
+     - load/store pipelining on M3/M4: a single load or store right
+       after a load takes one cycle less, unless it uses the loaded
+       register for its address,
+     - the 32 cycle iterative multiplier of M0/M0+ when slow_mul is set.
+
+   cost_range is a static estimate of straight-line code: conditional
+   branches fall through, unconditional ones are taken and instructions
+   inside IT blocks execute. Data (literal pools) adds bytes but no
+   cycles.
+*/
+
+typedef struct {
+  target_t target;
+  bool slow_mul;   /* M0/M0+ implemented with the small multiplier */
+} cost_model_t;
+
+typedef struct {
+  unsigned int cycles;
+  unsigned int bytes;
+  unsigned int instructions;
+} cost_t;
+
+extern void cost_model_init(cost_model_t *m, target_t target);
+
+/* Cycles of one instruction. prev is the instruction executed just
+   before it (or NULL), taken is false for a branch that is not taken
+   or an instruction whose condition fails. */
+extern unsigned int cost_insn(const cost_model_t *m, const insn_t *in,
+			      const insn_t *prev, bool taken);
+
+/* Cycles of an encoder result, branches taken */
+extern unsigned int cost_opcode(const cost_model_t *m, thumb_opcode_t op);
+
+extern int cost_range(const cost_model_t *m, instr_seq_t *seq,
+		      unsigned int start, unsigned int end, cost_t *out);
+extern int cost_seq(const cost_model_t *m, instr_seq_t *seq, cost_t *out);
+
+#endif
@@ -0,0 +1,111 @@
+/**********************************************************************************/
+/* MIT License									  */
+/* 										  */
+/* Copyright (c) 2020 Joel Svensson             				  */
+/* 										  */
+/* Permission is hereby granted, free of charge, to any person obtaining a copy	  */
+/* of this software and associated documentation files (the "Software"), to deal  */
+/* in the Software without restriction, including without limitation the rights	  */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell	  */
+/* copies of the Software, and to permit persons to whom the Software is	  */
+/* furnished to do so, subject to the following conditions:			  */
+/* 										  */
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software.				  */
+/* 										  */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR	  */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,	  */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE	  */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER	  */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,  */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE  */
+/* SOFTWARE.									  */
+/**********************************************************************************/
+
+#ifndef __DECODE_H_
+#define __DECODE_H_
+
+#include <thumb.h>
+
+/*
+   Decoding Thumb and Thumb-2 (ARMv6-M and ARMv7-M) instructions into
+   a common form, used by the simulator, the cost model and the
+   disassembler.
+
+   Data processing is rd = rn <op> operand2 where operand2 is either
+   imm (INSN_IMM) or rm shifted by shift/amount. 16bit shifts by an
+   immediate decode as MOV with a shifted operand, like their 32bit
+   counterparts. Loads and stores address rn + imm or rn + (rm << amount).
+   Branch offsets in imm are relative to the PC value (the instruction
+   address + 4).
+*/
+
+typedef enum {
+  insn_undefined,
+
+  /* data processing */
+  insn_and, insn_eor, insn_orr, insn_orn, insn_bic, insn_mov, insn_mvn,
+  insn_add, insn_adc, insn_sub, insn_sbc, insn_rsb,
+  insn_tst, insn_teq, insn_cmp, insn_cmn,
+  insn_lsl, insn_lsr, insn_asr, insn_ror,      /* shift by register */
+  insn_mul, insn_mla, insn_mls,
+  insn_smull, insn_umull, insn_smlal, insn_umlal,
+  insn_sdiv, insn_udiv,
+  insn_clz, insn_rev, insn_rev16, insn_revsh, insn_rbit,
+  insn_sxtb, insn_sxth, insn_uxtb, insn_uxth,  /* rm rotated by amount */
+  insn_movt, insn_bfi, insn_bfc, insn_sbfx, insn_ubfx,
+  insn_adr,
+
+  /* memory */
+  insn_ldr, insn_ldrb, insn_ldrh, insn_ldrsb, insn_ldrsh,
+  insn_str, insn_strb, insn_strh,
+  insn_ldrd, insn_strd,
+  insn_ldm, insn_stm,
+
+  /* control */
+  insn_b, insn_bl, insn_bx, insn_blx, insn_cbz, insn_cbnz,
+  insn_tbb, insn_tbh, insn_it,
+  insn_svc, insn_bkpt, insn_udf,
+
+  /* system */
+  insn_nop, insn_barrier, insn_mrs, insn_msr, insn_cps,
+
+  insn_count
+} insn_op_t;
+
+#define INSN_S     0x01  /* sets flags */
+#define INSN_IMM   0x02  /* operand2 / offset is imm */
+#define INSN_INDEX 0x04  /* address with the offset applied (else post-indexed) */
+#define INSN_ADD   0x08  /* add the offset (else subtract) */
+#define INSN_WBACK 0x10  /* write the address back to rn */
+#define INSN_DB    0x20  /* LDM/STM decrement before */
+#define INSN_V7    0x40  /* not in ARMv6-M */
+
+#define INSN_CARRY_NONE 2
+
+typedef struct {
+  uint8_t op;       /* insn_op_t */
+  uint8_t size;     /* halfwords */
+  uint8_t cond;     /* cond_al unless conditional (B<c> or inside IT) */
+  uint8_t flags;
+  uint8_t rd, rn, rm, ra; /* ra: accumulator, RdHi of long multiplies, Rt2 of LDRD/STRD */
+  uint8_t shift;    /* imm_shift_t applied to rm */
+  uint8_t amount;   /* shift amount, lsb for bitfields, rotation for extends */
+  uint8_t carry;    /* carry out of an expanded immediate or INSN_CARRY_NONE */
+  uint16_t list;    /* registers of LDM/STM */
+  uint32_t imm;
+} insn_t;
+
+/* Decode the instruction starting at hw (n halfwords available).
+   in_it tells if the instruction is inside an IT block, which turns
+   off flag setting for most 16bit data processing. Returns the size
+   in halfwords, or 0 if hw does not hold a whole instruction. */
+extern unsigned int decode(const uint16_t *hw, unsigned int n, bool in_it, insn_t *out);
+
+/* Does the instruction (possibly) write the PC */
+extern bool insn_is_branch(const insn_t *in);
+
+/* Value of a modified immediate (ThumbExpandImm) */
+extern uint32_t thumb32_expand_imm(uint32_t imm12);
+
+#endif
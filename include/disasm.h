@@ -0,0 +1,47 @@
+#ifndef __DISASM_H_
+#define __DISASM_H_
+
+#include <thumb.h>
+#include <decode.h>
+
+/*
+   Disassembler for the Thumb and Thumb-2 instructions the decoder
+   knows, printing UAL syntax in lower case (the form accepted by
+   arm-none-eabi-as).
+
+   disasm_insn formats an already decoded instruction; branch and
+   literal targets are printed as addresses, computed from the address
+   given for the instruction. Output is truncated to size (always zero
+   terminated). Nothing is allocated and stdio is not used, so it is
+   cheap enough to run on everything that is generated.
+
+   disasm_seq produces a listing of a sequence, one line per
+   instruction, passed to fn without the newline:
+
+     L0:
+     20000000:  2001       movs r0, #1
+     20000002:  f240 1234  movw r1, #4660
+     20000006:  d1fb       bne 0x20000000 <L0>
+     20000008:  4801       ldr r0, [pc, #4]  ; 0x20000010 = 0x12345678
+     20000010:  5678 1234  .word 0x12345678
+
+   Bound labels are printed before the instruction they point to and
+   after branch targets. Data ranges (literal pools) are printed as
+   .word/.short. Instructions in IT blocks get their condition.
+*/
+
+#define DISASM_LINE 96   /* enough for any line of disasm_seq */
+
+typedef void (*disasm_line_fn)(void *user, const char *line);
+
+extern unsigned int disasm_insn(const insn_t *in, uint32_t addr, char *buf, unsigned int size);
+
+/* Decode and format the instruction at hw. Returns its size in
+   halfwords or 0 if n is too small. */
+extern unsigned int disasm(const uint16_t *hw, unsigned int n, uint32_t addr,
+			   char *buf, unsigned int size);
+
+/* List the sequence as if loaded at base */
+extern int disasm_seq(instr_seq_t *seq, uint32_t base, disasm_line_fn fn, void *user);
+
+#endif
@@ -0,0 +1,117 @@
+/**********************************************************************************/
+/* MIT License									  */
+/* 										  */
+/* Copyright (c) 2020 Joel Svensson             				  */
+/* 										  */
+/* Permission is hereby granted, free of charge, to any person obtaining a copy	  */
+/* of this software and associated documentation files (the "Software"), to deal  */
+/* in the Software without restriction, including without limitation the rights	  */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell	  */
+/* copies of the Software, and to permit persons to whom the Software is	  */
+/* furnished to do so, subject to the following conditions:			  */
+/* 										  */
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software.				  */
+/* 										  */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR	  */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,	  */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE	  */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER	  */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,  */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE  */
+/* SOFTWARE.									  */
+/**********************************************************************************/
+
+#ifndef __LABELS_H_
+#define __LABELS_H_
+
+#include <thumb.h>
+
+/*
+   Labels and forward references.
+
+   Branches to labels are emitted with emit_branch/emit_bl. A branch to
+   a bound label gets the shortest encoding that reaches it. A branch to
+   a label that is not yet bound is emitted in its 16bit form and
+   patched when the label is bound. If it turns out not to reach,
+   seq_resolve relaxes it to the long form (a 32bit B<c>/B.W on M3/M4,
+   an inverted B<c> over a B on M0) and moves the code that follows.
+
+   Anything else whose encoding depends on where code ends up (literal
+   loads, alignment padding) is recorded as a fixup as well so that it
+   is redone when code moves. Data placed among the code is recorded
+   as a data range so that passes over the code can skip it.
+*/
+
+typedef int label_t;
+
+#define LABEL_NONE    (-1)
+#define LABEL_UNBOUND 0xFFFFFFFF
+
+typedef enum {
+  fixup_branch,  /* B<c> and B */
+  fixup_bl,
+  fixup_literal, /* LDR (literal) of a pool entry, see literals.h */
+  fixup_align    /* 0 or 1 halfword of padding to a word boundary */
+} fixup_kind_t;
+
+typedef struct {
+  unsigned int offset; /* halfword offset of the instruction */
+  label_t label;
+  int next;            /* next fixup waiting for the same label */
+  uint8_t kind;
+  uint8_t cond;
+  uint8_t reg;
+  uint8_t size;        /* halfwords reserved for the instruction */
+} fixup_t;
+
+typedef struct {
+  unsigned int offset; /* LABEL_UNBOUND until bound */
+  unsigned int nfix;   /* fixups emitted before the label was bound */
+  int waiting;         /* first fixup waiting for the label */
+} label_info_t;
+
+/* Data in the middle of the code (literal pool entries) */
+typedef struct {
+  unsigned int offset;
+  unsigned int size;   /* halfwords */
+  unsigned int nfix;   /* fixups emitted before the data */
+} data_range_t;
+
+struct lit_pool_s;
+
+typedef struct fixup_table_s {
+  label_info_t *labels;
+  unsigned int n_labels;
+  unsigned int labels_size;
+
+  fixup_t *fixups;
+  unsigned int n_fixups;
+  unsigned int fixups_size;
+
+  data_range_t *data;
+  unsigned int n_data;
+  unsigned int data_size;
+
+  unsigned int relax; /* fixups that did not fit when their label was bound */
+
+  struct lit_pool_s *pool;
+} fixup_table_t;
+
+extern label_t label_new(instr_seq_t *seq);
+extern int label_bind(instr_seq_t *seq, label_t l);
+extern unsigned int label_offset(instr_seq_t *seq, label_t l);
+
+extern int emit_branch(instr_seq_t *seq, cond_t cond, label_t l);
+extern int emit_bl(instr_seq_t *seq, label_t l);
+
+extern int seq_resolve(instr_seq_t *seq);
+
+extern fixup_table_t *fixups_get(instr_seq_t *seq);
+extern int emit_fixup(instr_seq_t *seq, fixup_t f);
+extern void fixups_free(instr_seq_t *seq);
+
+extern int emit_data_word(instr_seq_t *seq, uint32_t value);
+extern bool seq_is_data(instr_seq_t *seq, unsigned int offset);
+
+#endif
@@ -0,0 +1,68 @@
+/**********************************************************************************/
+/* MIT License									  */
+/* 										  */
+/* Copyright (c) 2020 Joel Svensson             				  */
+/* 										  */
+/* Permission is hereby granted, free of charge, to any person obtaining a copy	  */
+/* of this software and associated documentation files (the "Software"), to deal  */
+/* in the Software without restriction, including without limitation the rights	  */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell	  */
+/* copies of the Software, and to permit persons to whom the Software is	  */
+/* furnished to do so, subject to the following conditions:			  */
+/* 										  */
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software.				  */
+/* 										  */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR	  */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,	  */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE	  */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER	  */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,  */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE  */
+/* SOFTWARE.									  */
+/**********************************************************************************/
+
+#ifndef __LITERALS_H_
+#define __LITERALS_H_
+
+#include <thumb.h>
+#include <labels.h>
+
+/*
+   Literal pools for m0_ldr_lit.
+
+   lit_load emits LDR rd, [PC, #imm8*4] for a 32bit constant. Constants
+   are collected in a pending pool (identical values share one entry)
+   that is placed by lit_pool_flush, typically after the return at the
+   end of a function. If emission gets close to the end of the 1020 byte
+   forward range of the first load, the pool is placed automatically
+   as an island with a branch over it.
+
+   Pools are word aligned relative to the start of the sequence, so the
+   sequence itself must be loaded at a word aligned address.
+*/
+
+typedef struct {
+  uint32_t value;
+  label_t label;
+} lit_entry_t;
+
+typedef struct lit_pool_s {
+  lit_entry_t *entries;
+  unsigned int n;
+  unsigned int size;
+  unsigned int first_use; /* offset of the first load using the pending pool */
+  unsigned int slack;     /* branches after first_use that may still grow */
+} lit_pool_t;
+
+extern int lit_load(instr_seq_t *seq, reg_t rd, uint32_t value);
+extern int lit_pool_flush(instr_seq_t *seq);
+extern int lit_pool_island(instr_seq_t *seq);
+extern unsigned int lit_pool_pending(instr_seq_t *seq);
+extern bool lit_pool_has(instr_seq_t *seq, uint32_t value);
+
+/* used by labels.c */
+extern void lit_pool_note_fixup(instr_seq_t *seq, fixup_t *f);
+extern void lit_pool_free(instr_seq_t *seq);
+
+#endif
@@ -0,0 +1,54 @@
+/**********************************************************************************/
+/* MIT License									  */
+/* 										  */
+/* Copyright (c) 2020 Joel Svensson             				  */
+/* 										  */
+/* Permission is hereby granted, free of charge, to any person obtaining a copy	  */
+/* of this software and associated documentation files (the "Software"), to deal  */
+/* in the Software without restriction, including without limitation the rights	  */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell	  */
+/* copies of the Software, and to permit persons to whom the Software is	  */
+/* furnished to do so, subject to the following conditions:			  */
+/* 										  */
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software.				  */
+/* 										  */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR	  */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,	  */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE	  */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER	  */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,  */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE  */
+/* SOFTWARE.									  */
+/**********************************************************************************/
+
+#ifndef __PEEPHOLE_H_
+#define __PEEPHOLE_H_
+
+#include <thumb.h>
+#include <labels.h>
+
+/*
+   Peephole pass over an emitted sequence.
+
+   The rules are listed in a table in peephole.c. Each looks at a
+   window of consecutive instructions and may rewrite it into
+   something shorter or faster. Windows never extend across a label
+   (other than at their first instruction), fixups other than those a
+   rule is written for, or data. Rules that change the flags only apply
+   when the flags are overwritten before they can be read.
+
+   The pass needs every label used by the code to be bound and the
+   literal pool to be placed. Afterwards labels, fixups and data are
+   moved to their new offsets and the sequence is resolved again.
+*/
+
+typedef struct {
+  unsigned int rewrites; /* rules applied */
+  unsigned int bytes;    /* bytes saved */
+  unsigned int cycles;   /* cycles saved, estimated per rule */
+} peephole_stats_t;
+
+extern int peephole_run(instr_seq_t *seq, peephole_stats_t *stats);
+
+#endif
@@ -0,0 +1,104 @@
+/**********************************************************************************/
+/* MIT License									  */
+/* 										  */
+/* Copyright (c) 2020 Joel Svensson             				  */
+/* 										  */
+/* Permission is hereby granted, free of charge, to any person obtaining a copy	  */
+/* of this software and associated documentation files (the "Software"), to deal  */
+/* in the Software without restriction, including without limitation the rights	  */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell	  */
+/* copies of the Software, and to permit persons to whom the Software is	  */
+/* furnished to do so, subject to the following conditions:			  */
+/* 										  */
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software.				  */
+/* 										  */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR	  */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,	  */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE	  */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER	  */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,  */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE  */
+/* SOFTWARE.									  */
+/**********************************************************************************/
+
+#ifndef __REGALLOC_H_
+#define __REGALLOC_H_
+
+#include <thumb.h>
+
+/*
+   Linear scan register allocation over virtual registers.
+
+   Code is first described to the allocator: ra_use for every read or
+   write of a virtual register and ra_next between instructions. A
+   value that is live around a loop needs a use at the end of the loop.
+   ra_allocate then assigns physical registers for whole live ranges:
+
+     1. a linear scan over the low registers (r0 - r7), where the
+        ranges with the highest weight win, so the hottest values can
+        use the 16bit encodings,
+     2. a linear scan over the high registers for what is left. On M0
+        only ranges used without RA_LOW get a high register,
+     3. the rest is spilled to word slots at SP. Two low registers are
+        then kept as scratch for ra_fetch/ra_writeback, which use
+        m0_ldr_imm8/m0_str_imm8.
+
+   ra_frame_size is the number of bytes to reserve below SP for spill
+   slots, and ra_used the registers the allocation touches (for saving
+   callee-saved registers).
+*/
+
+typedef int vreg_t;
+
+#define VREG_NONE  (-1)
+#define RA_SPILLED (-1)
+
+/* flags for ra_use */
+#define RA_LOW 1  /* used by an instruction that only has a low register form */
+
+typedef struct {
+  unsigned int start;
+  unsigned int end;
+  unsigned int weight;
+  bool low;        /* some use wants a low register */
+  int reg;         /* reg_t or RA_SPILLED */
+  int slot;        /* spill slot (words from SP) or -1 */
+} vreg_info_t;
+
+typedef struct {
+  vreg_info_t *vregs;
+  unsigned int n;
+  unsigned int size;
+
+  unsigned int pos;
+  unsigned int weight;  /* added per use, see ra_set_weight */
+  uint16_t regs;        /* physical registers available */
+  uint16_t used;
+  reg_t scratch[2];
+  unsigned int n_slots;
+
+  target_t target;
+  seq_alloc_fn alloc;
+  seq_free_fn free;
+} regalloc_t;
+
+extern void ra_init(regalloc_t *ra, instr_seq_t *seq, uint16_t regs);
+extern void ra_free(regalloc_t *ra);
+
+extern vreg_t ra_new(regalloc_t *ra);
+extern int ra_use(regalloc_t *ra, vreg_t v, unsigned int flags);
+extern void ra_next(regalloc_t *ra);
+extern void ra_set_weight(regalloc_t *ra, unsigned int weight);
+
+extern int ra_allocate(regalloc_t *ra);
+
+extern int ra_reg(regalloc_t *ra, vreg_t v);
+extern unsigned int ra_frame_size(regalloc_t *ra);
+extern uint16_t ra_used(regalloc_t *ra);
+
+extern int ra_fetch(regalloc_t *ra, instr_seq_t *seq, vreg_t v, unsigned int scratch);
+extern reg_t ra_dest(regalloc_t *ra, vreg_t v, unsigned int scratch);
+extern int ra_writeback(regalloc_t *ra, instr_seq_t *seq, vreg_t v, reg_t r);
+
+#endif
@@ -0,0 +1,120 @@
+/**********************************************************************************/
+/* MIT License									  */
+/* 										  */
+/* Copyright (c) 2020 Joel Svensson             				  */
+/* 										  */
+/* Permission is hereby granted, free of charge, to any person obtaining a copy	  */
+/* of this software and associated documentation files (the "Software"), to deal  */
+/* in the Software without restriction, including without limitation the rights	  */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell	  */
+/* copies of the Software, and to permit persons to whom the Software is	  */
+/* furnished to do so, subject to the following conditions:			  */
+/* 										  */
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software.				  */
+/* 										  */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR	  */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,	  */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE	  */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER	  */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,  */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE  */
+/* SOFTWARE.									  */
+/**********************************************************************************/
+
+#ifndef __SEQ_H_
+#define __SEQ_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+   An instruction sequence is either a single fixed buffer provided
+   by the caller (seq_init) or a chain of fixed-size chunks
+   (seq_init_chunked). In chunked mode emission never fails for
+   lack of space, a new chunk is linked in when the current one is
+   full and nothing already emitted is moved.
+
+   mc, size and pos always describe the chunk currently written to,
+   so the emit fast path is the same in both modes.
+
+   A mark asks for a callback when emission reaches a given offset
+   (used to place literal pools before they go out of range). It is
+   implemented by lowering size, so it costs nothing on the fast path.
+   seq_hold/seq_release bracket instructions that must stay together;
+   a mark reached in between fires at seq_release.
+*/
+
+/* Core the code is generated for. M0/M0+ (ARMv6-M) only have the
+   16bit instructions plus a few 32bit ones, M3/M4 (ARMv7-M) add Thumb-2. */
+typedef enum {
+  target_m0,
+  target_m0plus,
+  target_m3,
+  target_m4
+} target_t;
+
+#define TARGET_HAS_THUMB2(t) ((t) >= target_m3)
+
+struct fixup_table_s;
+
+typedef struct instr_chunk_s {
+  struct instr_chunk_s *next;
+  uint16_t *mc;
+  unsigned int size;   /* capacity in halfwords */
+  unsigned int used;   /* halfwords emitted (valid after seq_chunks) */
+  unsigned int start;  /* offset (in halfwords) of mc[0] in the sequence */
+  bool owned;          /* allocated by the sequence */
+} instr_chunk_t;
+
+#define SEQ_NO_MARK 0xFFFFFFFF
+
+typedef void *(*seq_alloc_fn)(size_t bytes);
+typedef void (*seq_free_fn)(void *ptr);
+
+struct instr_seq_s;
+typedef void (*seq_mark_fn)(struct instr_seq_s *seq);
+
+typedef struct instr_seq_s {
+  uint16_t *mc;
+  unsigned int size;
+  unsigned int pos;
+
+  instr_chunk_t head;
+  instr_chunk_t *cur;
+  unsigned int chunk_size; /* 0 for a fixed buffer */
+  seq_alloc_fn alloc;
+  seq_free_fn free;
+
+  unsigned int mark;
+  seq_mark_fn mark_fn;
+  unsigned int hold;
+
+  target_t target;
+  struct fixup_table_s *fix; /* labels and pending fixups, see labels.h */
+} instr_seq_t;
+
+extern void seq_init(instr_seq_t *seq, uint16_t *mc, unsigned int size);
+extern void seq_init_chunked(instr_seq_t *seq, uint16_t *mc, unsigned int size,
+			     unsigned int chunk_size);
+extern void seq_set_allocator(instr_seq_t *seq, seq_alloc_fn alloc, seq_free_fn free);
+extern void seq_set_target(instr_seq_t *seq, target_t target);
+extern void seq_free(instr_seq_t *seq);
+
+/* Called by emit_opcode when the current chunk cannot hold n more halfwords */
+extern int seq_grow(instr_seq_t *seq, unsigned int n);
+
+extern void seq_set_mark(instr_seq_t *seq, unsigned int offset, seq_mark_fn fn);
+extern void seq_clear_mark(instr_seq_t *seq);
+extern void seq_hold(instr_seq_t *seq);
+extern void seq_release(instr_seq_t *seq);
+
+extern unsigned int seq_offset(instr_seq_t *seq);
+extern unsigned int seq_length(instr_seq_t *seq);
+extern uint16_t *seq_at(instr_seq_t *seq, unsigned int offset);
+extern instr_chunk_t *seq_chunks(instr_seq_t *seq);
+extern unsigned int seq_flatten(instr_seq_t *seq, uint16_t *out, unsigned int size);
+extern int seq_rewrite(instr_seq_t *seq, const uint16_t *mc, unsigned int n);
+
+#endif
@@ -0,0 +1,120 @@
+/**********************************************************************************/
+/* MIT License									  */
+/* 										  */
+/* Copyright (c) 2020 Joel Svensson             				  */
+/* 										  */
+/* Permission is hereby granted, free of charge, to any person obtaining a copy	  */
+/* of this software and associated documentation files (the "Software"), to deal  */
+/* in the Software without restriction, including without limitation the rights	  */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell	  */
+/* copies of the Software, and to permit persons to whom the Software is	  */
+/* furnished to do so, subject to the following conditions:			  */
+/* 										  */
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software.				  */
+/* 										  */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR	  */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,	  */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE	  */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER	  */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,  */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE  */
+/* SOFTWARE.									  */
+/**********************************************************************************/
+
+#ifndef __SIM_H_
+#define __SIM_H_
+
+#include <thumb.h>
+#include <decode.h>
+#include <cost.h>
+
+/*
+   Host side simulator for ARMv6-M (M0, M0+) and ARMv7-M (M3, M4)
+   code, for running generated sequences without hardware.
+
+   Memory is one flat RAM region at SIM_BASE holding both code and
+   data; SP starts at the top of it. Code is decoded once into basic
+   blocks, a run of instructions ending in something that may write
+   the PC, that are then executed from the cache. Stores into decoded
+   code drop the cache, so patched code is picked up.
+
+   sim_call runs a function until it returns to the caller (the LR it
+   was given), hits a BKPT, an undefined instruction, a fault or the
+   step limit. SVC calls the svc hook, and stops the run if there is
+   no hook or it returns 0.
+
+   Each executed instruction also adds its cost_insn estimate to
+   cycles, for the current target and the slow_mul setting of cost.
+*/
+
+#define SIM_BASE   0x20000000u
+#define SIM_RETURN 0xFFFFFFFEu  /* LR given by sim_call (with the thumb bit) */
+
+typedef enum {
+  sim_running,
+  sim_done,       /* returned from sim_call */
+  sim_bkpt,
+  sim_svc,
+  sim_undefined,  /* also instructions the target does not have */
+  sim_fault,      /* bad memory access or alignment, see fault_addr */
+  sim_limit       /* the step limit was reached */
+} sim_status_t;
+
+typedef struct {
+  uint32_t addr;
+  unsigned int n;      /* instructions */
+  unsigned int first;  /* in insns */
+} sim_block_t;
+
+struct sim_s;
+typedef int (*sim_svc_fn)(struct sim_s *sim, uint32_t imm);
+
+typedef struct sim_s {
+  uint32_t r[16];
+  bool n, z, c, v;
+
+  uint8_t *mem;
+  uint32_t base;
+  uint32_t size;
+  target_t target;
+
+  uint64_t steps;      /* instructions executed since sim_call */
+  uint64_t cycles;     /* estimated by the cost model, since sim_call */
+  cost_model_t cost;
+  uint64_t limit;      /* stop after this many steps, 0 for no limit */
+  sim_status_t status;
+  uint32_t fault_addr;
+
+  sim_svc_fn svc;
+  void *user;
+
+  /* decoded blocks */
+  sim_block_t *blocks;
+  unsigned int n_blocks;
+  unsigned int blocks_size;
+  insn_t *insns;
+  unsigned int n_insns;
+  unsigned int insns_size;
+  int32_t *block_at;   /* block index per halfword of memory, -1 if none */
+  uint32_t code_lo;    /* range covered by decoded blocks */
+  uint32_t code_hi;
+  unsigned int flushes;
+} sim_t;
+
+extern int sim_init(sim_t *sim, target_t target, uint32_t size);
+extern void sim_free(sim_t *sim);
+extern void sim_reset(sim_t *sim);
+extern void sim_flush(sim_t *sim);
+
+/* Copy the halfwords of a sequence to addr */
+extern int sim_load(sim_t *sim, uint32_t addr, instr_seq_t *seq);
+extern int sim_write(sim_t *sim, uint32_t addr, const void *data, uint32_t n);
+extern int sim_read(sim_t *sim, uint32_t addr, void *data, uint32_t n);
+extern uint32_t sim_read32(sim_t *sim, uint32_t addr);
+extern int sim_write32(sim_t *sim, uint32_t addr, uint32_t value);
+
+extern sim_status_t sim_run(sim_t *sim);
+extern sim_status_t sim_call(sim_t *sim, uint32_t addr, unsigned int argc, const uint32_t *args);
+
+#endif
@@ -29,9 +29,11 @@
 #include <stdint.h>
 #include <instructions.h>
 #include <registers.h>
+#include <seq.h>
 
 
 #define IMM7_MASK (uint8_t)0b01111111
+#define IMM6_MASK (uint8_t)0b00111111
 #define IMM5_MASK (uint8_t)0b00011111
 #define IMM3_MASK (uint8_t)0b00000111
 #define IMM2_MASK (uint8_t)0b00000011
@@ -61,6 +63,27 @@ typedef enum {
   imm_shift_none
 } imm_shift_t;
 
+/* Condition codes as encoded in conditional branches (and IT) */
+typedef enum {
+  cond_eq = 0,
+  cond_ne,
+  cond_cs,
+  cond_cc,
+  cond_mi,
+  cond_pl,
+  cond_vs,
+  cond_vc,
+  cond_hi,
+  cond_ls,
+  cond_ge,
+  cond_lt,
+  cond_gt,
+  cond_le,
+  cond_al
+} cond_t;
+
+#define COND_INVERT(c) ((cond_t)((c) ^ 1))
+
 typedef uint16_t thumb16_opcode_t;
 
 typedef struct {
@@ -84,13 +107,11 @@ typedef struct {
   } opcode;
 } thumb_opcode_t;
 
-typedef struct {
-  uint16_t *mc;
-  unsigned int size;
-  unsigned int pos;
-} instr_seq_t;
-
 extern int emit_opcode(instr_seq_t *seq, thumb_opcode_t op);
+extern int emit_opcode_at(instr_seq_t *seq, unsigned int offset, thumb_opcode_t op);
+
+/* Thumb-2 modified immediate for value, -1 if there is none */
+extern int32_t thumb32_encode_mod_imm(uint32_t value);
 
 /* handcoded */
 extern thumb_opcode_t m3_bfc(reg_t rd, uint8_t lsb, uint8_t width);
@@ -221,10 +242,47 @@ extern thumb_opcode_t m3_ble(int32_t offset);
 extern thumb_opcode_t m3_bal(int32_t offset);
 extern thumb_opcode_t m3_b(int32_t offset);
 extern thumb_opcode_t m3_bic_imm(reg_t rd, reg_t rn, uint16_t imm12, bool sf);
-extern thumb_opcode_t m3_bid_any(reg_t rd, reg_t rn, reg_t rm, uint8_t imm5, imm_shift_t shift, bool sf);
+extern thumb_opcode_t m3_bic_any(reg_t rd, reg_t rn, reg_t rm, uint8_t imm5, imm_shift_t shift, bool sf);
 extern thumb_opcode_t m3_clrex(void);
 extern thumb_opcode_t m3_clz(reg_t rd, reg_t rn, reg_t rm);
-extern thumb_opcode_t m3_cmn_imm(reg_t rd, uint16_t imm12);
-extern thumb_opcode_t m3_cmn_any(reg_t rd, reg_t rn, uint8_t imm5, imm_shift_t shift);
+extern thumb_opcode_t m3_cmn_imm(reg_t rn, uint16_t imm12);
+extern thumb_opcode_t m3_cmn_any(reg_t rn, reg_t rm, uint8_t imm5, imm_shift_t shift);
+extern thumb_opcode_t m3_cmp_imm(reg_t rn, uint16_t imm12);
+extern thumb_opcode_t m3_cmp_any(reg_t rn, reg_t rm, uint8_t imm5, imm_shift_t shift);
+extern thumb_opcode_t m3_csdb(void);
+extern thumb_opcode_t m3_eor_imm(reg_t rd, reg_t rn, uint16_t imm12, bool sf);
+extern thumb_opcode_t m3_eor_any(reg_t rd, reg_t rn, reg_t rm, uint8_t imm5, imm_shift_t shift, bool sf);
+extern thumb_opcode_t m3_ldm(reg_t rn, uint16_t rl);
+extern thumb_opcode_t m3_ldmw(reg_t rn, uint16_t rl);
+extern thumb_opcode_t m3_ldmdb(reg_t rn, uint16_t rl);
+extern thumb_opcode_t m3_ldmdbw(reg_t rn, uint16_t rl);
+extern thumb_opcode_t m3_ldr_imm(reg_t rd, reg_t rn, uint16_t imm12);
+extern thumb_opcode_t m3_mov_imm(reg_t rd, uint16_t imm12, bool sf);
+extern thumb_opcode_t m3_movw(reg_t rd, uint16_t imm16);
+extern thumb_opcode_t m3_movt(reg_t rd, uint16_t imm16);
+extern thumb_opcode_t m3_mvn_imm(reg_t rd, uint16_t imm12, bool sf);
+extern thumb_opcode_t m3_orn_imm(reg_t rd, reg_t rn, uint16_t imm12, bool sf);
+extern thumb_opcode_t m3_orr_imm(reg_t rd, reg_t rn, uint16_t imm12, bool sf);
+extern thumb_opcode_t m3_rsb_imm(reg_t rd, reg_t rn, uint16_t imm12, bool sf);
+extern thumb_opcode_t m3_sbc_imm(reg_t rd, reg_t rn, uint16_t imm12, bool sf);
+extern thumb_opcode_t m3_sub_const(reg_t rd, reg_t rn, uint16_t imm12, bool sf);
+extern thumb_opcode_t m3_teq_imm(reg_t rn, uint16_t imm12);
+extern thumb_opcode_t m3_tst_imm(reg_t rn, uint16_t imm12);
+extern thumb_opcode_t m3_adc_const32(reg_t rd, reg_t rn, uint32_t value, bool sf);
+extern thumb_opcode_t m3_add_const32(reg_t rd, reg_t rn, uint32_t value, bool sf);
+extern thumb_opcode_t m3_and_const32(reg_t rd, reg_t rn, uint32_t value, bool sf);
+extern thumb_opcode_t m3_bic_const32(reg_t rd, reg_t rn, uint32_t value, bool sf);
+extern thumb_opcode_t m3_cmn_const32(reg_t rn, uint32_t value);
+extern thumb_opcode_t m3_cmp_const32(reg_t rn, uint32_t value);
+extern thumb_opcode_t m3_eor_const32(reg_t rd, reg_t rn, uint32_t value, bool sf);
+extern thumb_opcode_t m3_mov_const32(reg_t rd, uint32_t value, bool sf);
+extern thumb_opcode_t m3_mvn_const32(reg_t rd, uint32_t value, bool sf);
+extern thumb_opcode_t m3_orn_const32(reg_t rd, reg_t rn, uint32_t value, bool sf);
+extern thumb_opcode_t m3_orr_const32(reg_t rd, reg_t rn, uint32_t value, bool sf);
+extern thumb_opcode_t m3_rsb_const32(reg_t rd, reg_t rn, uint32_t value, bool sf);
+extern thumb_opcode_t m3_sbc_const32(reg_t rd, reg_t rn, uint32_t value, bool sf);
+extern thumb_opcode_t m3_sub_const32(reg_t rd, reg_t rn, uint32_t value, bool sf);
+extern thumb_opcode_t m3_teq_const32(reg_t rn, uint32_t value);
+extern thumb_opcode_t m3_tst_const32(reg_t rn, uint32_t value);
 
 #endif
@@ -0,0 +1,146 @@
+/**********************************************************************************/
+/* MIT License									  */
+/* 										  */
+/* Copyright (c) 2020 Joel Svensson             				  */
+/* 										  */
+/* Permission is hereby granted, free of charge, to any person obtaining a copy	  */
+/* of this software and associated documentation files (the "Software"), to deal  */
+/* in the Software without restriction, including without limitation the rights	  */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell	  */
+/* copies of the Software, and to permit persons to whom the Software is	  */
+/* furnished to do so, subject to the following conditions:			  */
+/* 										  */
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software.				  */
+/* 										  */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR	  */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,	  */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE	  */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER	  */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,  */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE  */
+/* SOFTWARE.									  */
+/**********************************************************************************/
+
+#include <constants.h>
+#include <literals.h>
+
+/* value == imm8 << shift with shift in 1 .. 31 */
+static bool shifted_imm8(uint32_t value, uint32_t *imm8, uint32_t *shift) {
+  if (value == 0) return false;
+  uint32_t s = __builtin_ctz(value);
+  if (s == 0 || (value >> s) > 0xFF) return false;
+  *imm8 = value >> s;
+  *shift = s;
+  return true;
+}
+
+static void consider(const_plan_t *best, const_policy_t policy,
+		     const_strategy_t strategy, unsigned int bytes, unsigned int cycles,
+		     uint32_t a, uint32_t b, uint32_t c) {
+  bool better;
+  if (best->strategy == const_none) {
+    better = true;
+  } else if (policy == const_min_bytes) {
+    better = bytes < best->bytes || (bytes == best->bytes && cycles < best->cycles);
+  } else {
+    better = cycles < best->cycles || (cycles == best->cycles && bytes < best->bytes);
+  }
+  if (!better) return;
+  best->strategy = strategy;
+  best->bytes = bytes;
+  best->cycles = cycles;
+  best->a = a;
+  best->b = b;
+  best->c = c;
+}
+
+bool const_plan(instr_seq_t *seq, reg_t rd, uint32_t value,
+		target_t target, const_policy_t policy, const_plan_t *plan) {
+  uint32_t a, b;
+  plan->strategy = const_none;
+
+  if (rd <= r7) {
+    if (value <= 0xFF)
+      consider(plan, policy, const_movs, 2, 1, value, 0, 0);
+    if (~value <= 0xFF)
+      consider(plan, policy, const_movs_mvns, 4, 2, ~value, 0, 0);
+    if (shifted_imm8(value, &a, &b))
+      consider(plan, policy, const_movs_lsls, 4, 2, a, b, 0);
+    if (value > 0xFF && value <= 0xFF + 0xFF)
+      consider(plan, policy, const_movs_adds, 4, 2, 0xFF, value - 0xFF, 0);
+    if (shifted_imm8(value & ~0xFF, &a, &b))
+      consider(plan, policy, const_movs_lsls_adds, 6, 3, a, b, value & 0xFF);
+    if (shifted_imm8(~value, &a, &b))
+      consider(plan, policy, const_movs_lsls_mvns, 6, 3, a, b, 0);
+
+    unsigned int bytes = lit_pool_has(seq, value) ? 2 : 6;
+    consider(plan, policy, const_literal, bytes, 2, value, 0, 0);
+  }
+
+  if (TARGET_HAS_THUMB2(target)) {
+    int32_t imm12 = thumb32_encode_mod_imm(value);
+    if (imm12 >= 0)
+      consider(plan, policy, const_mov_w, 4, 1, imm12, 0, 0);
+    imm12 = thumb32_encode_mod_imm(~value);
+    if (imm12 >= 0)
+      consider(plan, policy, const_mvn_w, 4, 1, imm12, 0, 0);
+    if (value <= 0xFFFF)
+      consider(plan, policy, const_movw, 4, 1, value, 0, 0);
+    else
+      consider(plan, policy, const_movw_movt, 8, 2, value & 0xFFFF, value >> 16, 0);
+  }
+
+  return plan->strategy != const_none;
+}
+
+int const_emit(instr_seq_t *seq, reg_t rd, const_plan_t *plan) {
+  int r = 1;
+  switch (plan->strategy) {
+  case const_movs:
+    return emit_opcode(seq, m0_mov_imm(rd, plan->a));
+  case const_movs_mvns:
+    r &= emit_opcode(seq, m0_mov_imm(rd, plan->a));
+    r &= emit_opcode(seq, m0_mvn_low(rd, rd));
+    return r;
+  case const_movs_lsls:
+    r &= emit_opcode(seq, m0_mov_imm(rd, plan->a));
+    r &= emit_opcode(seq, m0_lsl_imm5(rd, rd, plan->b));
+    return r;
+  case const_movs_adds:
+    r &= emit_opcode(seq, m0_mov_imm(rd, plan->a));
+    r &= emit_opcode(seq, m0_add_imm8(rd, plan->b));
+    return r;
+  case const_movs_lsls_adds:
+    r &= emit_opcode(seq, m0_mov_imm(rd, plan->a));
+    r &= emit_opcode(seq, m0_lsl_imm5(rd, rd, plan->b));
+    r &= emit_opcode(seq, m0_add_imm8(rd, plan->c));
+    return r;
+  case const_movs_lsls_mvns:
+    r &= emit_opcode(seq, m0_mov_imm(rd, plan->a));
+    r &= emit_opcode(seq, m0_lsl_imm5(rd, rd, plan->b));
+    r &= emit_opcode(seq, m0_mvn_low(rd, rd));
+    return r;
+  case const_mov_w:
+    return emit_opcode(seq, m3_mov_imm(rd, plan->a, false));
+  case const_mvn_w:
+    return emit_opcode(seq, m3_mvn_imm(rd, plan->a, false));
+  case const_movw:
+    return emit_opcode(seq, m3_movw(rd, plan->a));
+  case const_movw_movt:
+    r &= emit_opcode(seq, m3_movw(rd, plan->a));
+    r &= emit_opcode(seq, m3_movt(rd, plan->b));
+    return r;
+  case const_literal:
+    return lit_load(seq, rd, plan->a);
+  default:
+    return 0;
+  }
+}
+
+int load_constant(instr_seq_t *seq, reg_t rd, uint32_t value,
+		  target_t target, const_policy_t policy) {
+  const_plan_t plan;
+  if (!const_plan(seq, rd, value, target, policy, &plan)) return 0;
+  return const_emit(seq, rd, &plan);
+}
@@ -0,0 +1,222 @@
+/**********************************************************************************/
+/* MIT License									  */
+/* 										  */
+/* Copyright (c) 2020 Joel Svensson             				  */
+/* 										  */
+/* Permission is hereby granted, free of charge, to any person obtaining a copy	  */
+/* of this software and associated documentation files (the "Software"), to deal  */
+/* in the Software without restriction, including without limitation the rights	  */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell	  */
+/* copies of the Software, and to permit persons to whom the Software is	  */
+/* furnished to do so, subject to the following conditions:			  */
+/* 										  */
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software.				  */
+/* 										  */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR	  */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,	  */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE	  */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER	  */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,  */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE  */
+/* SOFTWARE.									  */
+/**********************************************************************************/
+
+#include <cost.h>
+#include <labels.h>
+
+#include <string.h>
+
+/* Cycles per instruction class on M0, M0+, M3, M4. For branches this
+   is the taken cost, refill included. */
+static const uint8_t cycles[insn_count][4] = {
+  [insn_undefined] = {0, 0, 0, 0},
+
+  [insn_and]   = {1, 1, 1, 1},
+  [insn_eor]   = {1, 1, 1, 1},
+  [insn_orr]   = {1, 1, 1, 1},
+  [insn_orn]   = {1, 1, 1, 1},
+  [insn_bic]   = {1, 1, 1, 1},
+  [insn_mov]   = {1, 1, 1, 1},
+  [insn_mvn]   = {1, 1, 1, 1},
+  [insn_add]   = {1, 1, 1, 1},
+  [insn_adc]   = {1, 1, 1, 1},
+  [insn_sub]   = {1, 1, 1, 1},
+  [insn_sbc]   = {1, 1, 1, 1},
+  [insn_rsb]   = {1, 1, 1, 1},
+  [insn_tst]   = {1, 1, 1, 1},
+  [insn_teq]   = {1, 1, 1, 1},
+  [insn_cmp]   = {1, 1, 1, 1},
+  [insn_cmn]   = {1, 1, 1, 1},
+  [insn_lsl]   = {1, 1, 1, 1},
+  [insn_lsr]   = {1, 1, 1, 1},
+  [insn_asr]   = {1, 1, 1, 1},
+  [insn_ror]   = {1, 1, 1, 1},
+  [insn_mul]   = {1, 1, 1, 1},
+  [insn_mla]   = {2, 2, 2, 1},
+  [insn_mls]   = {2, 2, 2, 1},
+  [insn_smull] = {5, 5, 5, 1},
+  [insn_umull] = {5, 5, 5, 1},
+  [insn_smlal] = {7, 7, 7, 1},
+  [insn_umlal] = {7, 7, 7, 1},
+  [insn_sdiv]  = {12, 12, 12, 12},
+  [insn_udiv]  = {12, 12, 12, 12},
+  [insn_clz]   = {1, 1, 1, 1},
+  [insn_rev]   = {1, 1, 1, 1},
+  [insn_rev16] = {1, 1, 1, 1},
+  [insn_revsh] = {1, 1, 1, 1},
+  [insn_rbit]  = {1, 1, 1, 1},
+  [insn_sxtb]  = {1, 1, 1, 1},
+  [insn_sxth]  = {1, 1, 1, 1},
+  [insn_uxtb]  = {1, 1, 1, 1},
+  [insn_uxth]  = {1, 1, 1, 1},
+  [insn_movt]  = {1, 1, 1, 1},
+  [insn_bfi]   = {1, 1, 1, 1},
+  [insn_bfc]   = {1, 1, 1, 1},
+  [insn_sbfx]  = {1, 1, 1, 1},
+  [insn_ubfx]  = {1, 1, 1, 1},
+  [insn_adr]   = {1, 1, 1, 1},
+
+  [insn_ldr]   = {2, 2, 2, 2},
+  [insn_ldrb]  = {2, 2, 2, 2},
+  [insn_ldrh]  = {2, 2, 2, 2},
+  [insn_ldrsb] = {2, 2, 2, 2},
+  [insn_ldrsh] = {2, 2, 2, 2},
+  [insn_str]   = {2, 2, 2, 2},
+  [insn_strb]  = {2, 2, 2, 2},
+  [insn_strh]  = {2, 2, 2, 2},
+  [insn_ldrd]  = {3, 3, 3, 3},
+  [insn_strd]  = {3, 3, 3, 3},
+  [insn_ldm]   = {1, 1, 1, 1},  /* + registers */
+  [insn_stm]   = {1, 1, 1, 1},
+
+  [insn_b]     = {3, 2, 3, 3},
+  [insn_bl]    = {4, 3, 3, 3},
+  [insn_bx]    = {3, 2, 3, 3},
+  [insn_blx]   = {3, 2, 3, 3},
+  [insn_cbz]   = {3, 2, 3, 3},
+  [insn_cbnz]  = {3, 2, 3, 3},
+  [insn_tbb]   = {4, 4, 4, 4},
+  [insn_tbh]   = {4, 4, 4, 4},
+  [insn_it]    = {1, 1, 1, 1},
+  [insn_svc]   = {1, 1, 1, 1},  /* exception entry not counted */
+  [insn_bkpt]  = {1, 1, 1, 1},
+  [insn_udf]   = {1, 1, 1, 1},
+
+  [insn_nop]     = {1, 1, 1, 1},
+  [insn_barrier] = {4, 3, 4, 4},
+  [insn_mrs]     = {4, 3, 2, 2},
+  [insn_msr]     = {4, 3, 2, 2},
+  [insn_cps]     = {1, 1, 1, 1},
+};
+
+static const uint8_t refill[4] = {2, 1, 2, 2};
+
+void cost_model_init(cost_model_t *m, target_t target) {
+  m->target = target;
+  m->slow_mul = false;
+}
+
+static bool is_single_load(const insn_t *in) {
+  return in->op >= insn_ldr && in->op <= insn_ldrsh;
+}
+
+unsigned int cost_insn(const cost_model_t *m, const insn_t *in,
+		       const insn_t *prev, bool taken) {
+  unsigned int t = m->target;
+  unsigned int c = cycles[in->op][t];
+
+  if (!taken) return 1;
+
+  switch (in->op) {
+  case insn_mul:
+    if (m->slow_mul && !TARGET_HAS_THUMB2(m->target)) c = 32;
+    break;
+  case insn_ldm: case insn_stm:
+    c += (unsigned int)__builtin_popcount(in->list);
+    if ((in->list >> PC) & 1 && in->op == insn_ldm) c += refill[t];
+    break;
+  case insn_ldr: case insn_ldrb: case insn_ldrh: case insn_ldrsb: case insn_ldrsh:
+  case insn_str: case insn_strb: case insn_strh:
+    if (TARGET_HAS_THUMB2(m->target) && prev && is_single_load(prev) &&
+	prev->rd != in->rn && ((in->flags & INSN_IMM) || prev->rd != in->rm))
+      c --;
+    if (in->rd == PC && is_single_load(in)) c += refill[t];
+    break;
+  case insn_add: case insn_mov:
+    if (in->rd == PC) c += refill[t];
+    break;
+  default:
+    break;
+  }
+  return c;
+}
+
+static unsigned int opcode_hw(thumb_opcode_t op, uint16_t *hw) {
+  switch (op.kind) {
+  case thumb16:
+    hw[0] = op.opcode.thumb16;
+    return 1;
+  case thumb32:
+    hw[0] = op.opcode.thumb32.high;
+    hw[1] = op.opcode.thumb32.low;
+    return 2;
+  default:
+    return 0;
+  }
+}
+
+unsigned int cost_opcode(const cost_model_t *m, thumb_opcode_t op) {
+  uint16_t hw[2];
+  insn_t in;
+  unsigned int n = opcode_hw(op, hw);
+  if (!n || !decode(hw, n, false, &in)) return 0;
+  return cost_insn(m, &in, NULL, true);
+}
+
+int cost_range(const cost_model_t *m, instr_seq_t *seq,
+	       unsigned int start, unsigned int end, cost_t *out) {
+  memset(out, 0, sizeof(cost_t));
+  if (end > seq_length(seq) || start > end) return 0;
+
+  insn_t cur, last;
+  bool have_last = false;
+  uint8_t it = 0;
+  unsigned int off = start;
+  while (off < end) {
+    if (seq_is_data(seq, off)) {
+      out->bytes += 2;
+      off ++;
+      have_last = false;
+      continue;
+    }
+    uint16_t hw[2];
+    unsigned int n = 1;
+    hw[0] = *seq_at(seq, off);
+    if (off + 1 < end) {
+      hw[1] = *seq_at(seq, off + 1);
+      n = 2;
+    }
+    if (!decode(hw, n, it != 0, &cur)) return 0;
+
+    bool taken = true;
+    if (it) {
+      it = (it & 7) == 0 ? 0 : (it & 0xE0) | ((it << 1) & 0x1F);
+    } else if (cur.op == insn_it) {
+      it = (uint8_t)cur.imm;
+    } else if (cur.cond != cond_al || cur.op == insn_cbz || cur.op == insn_cbnz) {
+      taken = false;
+    }
+    out->cycles += cost_insn(m, &cur, have_last ? &last : NULL, taken);
+    out->bytes += cur.size * 2;
+    out->instructions ++;
+    off += cur.size;
+    last = cur;
+    have_last = true;
+  }
+  return 1;
+}
+
+int cost_seq(const cost_model_t *m, instr_seq_t *seq, cost_t *out) {
+  return cost_range(m, seq, 0, seq_length(seq), out);
+}
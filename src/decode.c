@@ -0,0 +1,549 @@
+/**********************************************************************************/
+/* MIT License									  */
+/* 										  */
+/* Copyright (c) 2020 Joel Svensson             				  */
+/* 										  */
+/* Permission is hereby granted, free of charge, to any person obtaining a copy	  */
+/* of this software and associated documentation files (the "Software"), to deal  */
+/* in the Software without restriction, including without limitation the rights	  */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell	  */
+/* copies of the Software, and to permit persons to whom the Software is	  */
+/* furnished to do so, subject to the following conditions:			  */
+/* 										  */
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software.				  */
+/* 										  */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR	  */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,	  */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE	  */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER	  */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,  */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE  */
+/* SOFTWARE.									  */
+/**********************************************************************************/
+
+
+#include <decode.h>
+
+#include <string.h>
+
+static int32_t sign_extend(uint32_t value, unsigned int bits) {
+  uint32_t m = 1u << (bits - 1);
+  value &= (m << 1) - 1;
+  return (int32_t)((value ^ m) - m);
+}
+
+uint32_t thumb32_expand_imm(uint32_t imm12) {
+  uint32_t imm8 = imm12 & 0xFF;
+  if ((imm12 >> 10) == 0) {
+    switch ((imm12 >> 8) & 3) {
+    case 0: return imm8;
+    case 1: return (imm8 << 16) | imm8;
+    case 2: return (imm8 << 24) | (imm8 << 8);
+    default: return (imm8 << 24) | (imm8 << 16) | (imm8 << 8) | imm8;
+    }
+  }
+  uint32_t v = 0x80 | (imm12 & 0x7F);
+  unsigned int rot = imm12 >> 7;
+  return (v >> rot) | (v << (32 - rot));
+}
+
+/* DecodeImmShift */
+static void imm_shift(insn_t *in, unsigned int type, unsigned int imm5) {
+  switch (type) {
+  case 0:
+    in->shift = imm5 ? imm_shift_lsl : imm_shift_none;
+    in->amount = imm5;
+    break;
+  case 1:
+    in->shift = imm_shift_lsr;
+    in->amount = imm5 ? imm5 : 32;
+    break;
+  case 2:
+    in->shift = imm_shift_asr;
+    in->amount = imm5 ? imm5 : 32;
+    break;
+  default:
+    in->shift = imm5 ? imm_shift_ror : imm_shift_rrx;
+    in->amount = imm5 ? imm5 : 1;
+    break;
+  }
+}
+
+/* op field shared by the 32bit modified immediate and shifted register forms */
+static void dp32(insn_t *in, unsigned int op, bool s) {
+  bool test = s && in->rd == PC;
+  switch (op) {
+  case 0:  in->op = test ? insn_tst : insn_and; break;
+  case 1:  in->op = insn_bic; break;
+  case 2:  in->op = in->rn == PC ? insn_mov : insn_orr; break;
+  case 3:  in->op = in->rn == PC ? insn_mvn : insn_orn; break;
+  case 4:  in->op = test ? insn_teq : insn_eor; break;
+  case 8:  in->op = test ? insn_cmn : insn_add; break;
+  case 10: in->op = insn_adc; break;
+  case 11: in->op = insn_sbc; break;
+  case 13: in->op = test ? insn_cmp : insn_sub; break;
+  case 14: in->op = insn_rsb; break;
+  default: in->op = insn_undefined; return;
+  }
+  if (s) in->flags |= INSN_S;
+}
+
+static void decode16(uint16_t op, bool in_it, insn_t *in) {
+  uint8_t s = in_it ? 0 : INSN_S;
+  unsigned int lo = op & 7;
+  unsigned int mid = (op >> 3) & 7;
+  unsigned int hi8 = (op >> 8) & 7;
+
+  switch (op >> 11) {
+  case 0: case 1: case 2: /* LSL, LSR, ASR (immediate) */
+    in->op = insn_mov;
+    in->rd = lo;
+    in->rm = mid;
+    in->flags = s;
+    imm_shift(in, op >> 11, (op >> 6) & 0x1F);
+    return;
+  case 3: /* ADD, SUB (register or imm3) */
+    in->op = (op & 0x0200) ? insn_sub : insn_add;
+    in->rd = lo;
+    in->rn = mid;
+    in->flags = s;
+    if (op & 0x0400) {
+      in->flags |= INSN_IMM;
+      in->imm = (op >> 6) & 7;
+    } else {
+      in->rm = (op >> 6) & 7;
+    }
+    return;
+  case 4: case 5: case 6: case 7: { /* MOV, CMP, ADD, SUB (imm8) */
+    static const uint8_t ops[4] = {insn_mov, insn_cmp, insn_add, insn_sub};
+    in->op = ops[(op >> 11) & 3];
+    in->rd = hi8;
+    in->rn = hi8;
+    in->imm = op & 0xFF;
+    in->flags = INSN_IMM | (in->op == insn_cmp ? INSN_S : s);
+    return;
+  }
+  case 8:
+    if ((op & 0x0400) == 0) { /* data processing */
+      static const uint8_t ops[16] = {
+        insn_and, insn_eor, insn_lsl, insn_lsr, insn_asr, insn_adc, insn_sbc, insn_ror,
+        insn_tst, insn_rsb, insn_cmp, insn_cmn, insn_orr, insn_mul, insn_bic, insn_mvn};
+      in->op = ops[(op >> 6) & 0xF];
+      in->rd = lo;
+      in->rn = lo;
+      in->rm = mid;
+      in->flags = s;
+      switch (in->op) {
+      case insn_tst: case insn_cmp: case insn_cmn:
+        in->flags = INSN_S;
+        break;
+      case insn_rsb: /* RSBS rd, rn, #0 */
+        in->rn = mid;
+        in->flags |= INSN_IMM;
+        in->imm = 0;
+        break;
+      case insn_mul: /* MULS rdm, rn, rdm */
+        in->rn = mid;
+        in->rm = lo;
+        break;
+      default:
+        break;
+      }
+      return;
+    }
+    /* special data processing, branch and exchange */
+    in->rd = ((op >> 4) & 8) | lo;
+    in->rn = in->rd;
+    in->rm = (op >> 3) & 0xF;
+    switch ((op >> 8) & 3) {
+    case 0: in->op = insn_add; break;
+    case 1: in->op = insn_cmp; in->flags = INSN_S; break;
+    case 2: in->op = insn_mov; break;
+    default:
+      in->op = (op & 0x80) ? insn_blx : insn_bx;
+      if (op & 7) in->op = insn_undefined;
+      break;
+    }
+    return;
+  case 9: /* LDR (literal) */
+    in->op = insn_ldr;
+    in->rd = hi8;
+    in->rn = PC;
+    in->imm = (op & 0xFF) << 2;
+    in->flags = INSN_IMM | INSN_INDEX | INSN_ADD;
+    return;
+  case 10: case 11: { /* load/store register offset */
+    static const uint8_t ops[8] = {
+      insn_str, insn_strh, insn_strb, insn_ldrsb, insn_ldr, insn_ldrh, insn_ldrb, insn_ldrsh};
+    in->op = ops[(op >> 9) & 7];
+    in->rd = lo;
+    in->rn = mid;
+    in->rm = (op >> 6) & 7;
+    in->shift = imm_shift_none;
+    in->flags = INSN_INDEX | INSN_ADD;
+    return;
+  }
+  case 12: case 13: case 14: case 15: case 16: case 17: { /* load/store imm5 */
+    unsigned int kind = (op >> 11) - 12;
+    static const uint8_t ops[6] = {
+      insn_str, insn_ldr, insn_strb, insn_ldrb, insn_strh, insn_ldrh};
+    static const uint8_t scale[6] = {2, 2, 0, 0, 1, 1};
+    in->op = ops[kind];
+    in->rd = lo;
+    in->rn = mid;
+    in->imm = ((op >> 6) & 0x1F) << scale[kind];
+    in->flags = INSN_IMM | INSN_INDEX | INSN_ADD;
+    return;
+  }
+  case 18: case 19: /* STR, LDR (SP relative) */
+    in->op = (op & 0x0800) ? insn_ldr : insn_str;
+    in->rd = hi8;
+    in->rn = SP;
+    in->imm = (op & 0xFF) << 2;
+    in->flags = INSN_IMM | INSN_INDEX | INSN_ADD;
+    return;
+  case 20: /* ADR */
+    in->op = insn_adr;
+    in->rd = hi8;
+    in->rn = PC;
+    in->imm = (op & 0xFF) << 2;
+    in->flags = INSN_IMM | INSN_ADD;
+    return;
+  case 21: /* ADD rd, SP, #imm8 */
+    in->op = insn_add;
+    in->rd = hi8;
+    in->rn = SP;
+    in->imm = (op & 0xFF) << 2;
+    in->flags = INSN_IMM;
+    return;
+  case 22: case 23: /* miscellaneous */
+    if ((op & 0xFF00) == 0xB000) { /* ADD, SUB SP, SP, #imm7 */
+      in->op = (op & 0x80) ? insn_sub : insn_add;
+      in->rd = SP;
+      in->rn = SP;
+      in->imm = (op & 0x7F) << 2;
+      in->flags = INSN_IMM;
+    } else if ((op & 0xF500) == 0xB100) { /* CBZ, CBNZ */
+      in->op = (op & 0x0800) ? insn_cbnz : insn_cbz;
+      in->rn = lo;
+      in->imm = (((op >> 9) & 1) << 6) | (((op >> 3) & 0x1F) << 1);
+      in->flags = INSN_V7;
+    } else if ((op & 0xFF00) == 0xB200) { /* SXTH, SXTB, UXTH, UXTB */
+      static const uint8_t ops[4] = {insn_sxth, insn_sxtb, insn_uxth, insn_uxtb};
+      in->op = ops[(op >> 6) & 3];
+      in->rd = lo;
+      in->rm = mid;
+    } else if ((op & 0xFE00) == 0xB400) { /* PUSH */
+      in->op = insn_stm;
+      in->rn = SP;
+      in->list = (op & 0xFF) | ((op & 0x0100) << 6);
+      in->flags = INSN_DB | INSN_WBACK;
+    } else if ((op & 0xFFE8) == 0xB660) {
+      in->op = insn_cps;
+      in->imm = op & 0x1F;
+    } else if ((op & 0xFF00) == 0xBA00 && ((op >> 6) & 3) != 2) {
+      static const uint8_t ops[4] = {insn_rev, insn_rev16, insn_undefined, insn_revsh};
+      in->op = ops[(op >> 6) & 3];
+      in->rd = lo;
+      in->rm = mid;
+    } else if ((op & 0xFE00) == 0xBC00) { /* POP */
+      in->op = insn_ldm;
+      in->rn = SP;
+      in->list = (op & 0xFF) | ((op & 0x0100) << 7);
+      in->flags = INSN_WBACK;
+    } else if ((op & 0xFF00) == 0xBE00) {
+      in->op = insn_bkpt;
+      in->imm = op & 0xFF;
+    } else if ((op & 0xFF00) == 0xBF00) {
+      if (op & 0xF) {
+        in->op = insn_it;
+        in->imm = op & 0xFF;
+        in->flags = INSN_V7;
+      } else {
+        in->op = insn_nop; /* NOP, YIELD, WFE, WFI, SEV */
+        in->imm = (op >> 4) & 0xF;
+      }
+    }
+    return;
+  case 24: case 25: /* STM, LDM */
+    in->op = (op & 0x0800) ? insn_ldm : insn_stm;
+    in->rn = hi8;
+    in->list = op & 0xFF;
+    if (in->op == insn_stm || !(in->list & (1 << in->rn))) in->flags = INSN_WBACK;
+    return;
+  case 26: case 27: {
+    unsigned int cond = (op >> 8) & 0xF;
+    if (cond == 0xE) {
+      in->op = insn_udf;
+      in->imm = op & 0xFF;
+    } else if (cond == 0xF) {
+      in->op = insn_svc;
+      in->imm = op & 0xFF;
+    } else {
+      in->op = insn_b;
+      in->cond = cond;
+      in->imm = (uint32_t)sign_extend((op & 0xFF) << 1, 9);
+    }
+    return;
+  }
+  case 28:
+    in->op = insn_b;
+    in->imm = (uint32_t)sign_extend((op & 0x7FF) << 1, 12);
+    return;
+  default:
+    return;
+  }
+}
+
+static void load_store32(uint16_t op1, uint16_t op2, insn_t *in) {
+  unsigned int size = (op1 >> 5) & 3;
+  bool load = (op1 >> 4) & 1;
+  bool sign = (op1 >> 8) & 1;
+
+  in->rn = op1 & 0xF;
+  in->rd = op2 >> 12;
+  in->flags = INSN_V7;
+
+  if (size == 3 || (sign && (!load || size == 2))) return;
+  if (load) {
+    static const uint8_t ops[3][2] = {{insn_ldrb, insn_ldrsb},
+                                      {insn_ldrh, insn_ldrsh},
+                                      {insn_ldr, insn_ldr}};
+    in->op = ops[size][sign];
+  } else {
+    static const uint8_t ops[3] = {insn_strb, insn_strh, insn_str};
+    in->op = ops[size];
+  }
+
+  if (in->rn == PC) { /* literal */
+    if (!load) { in->op = insn_undefined; return; }
+    in->imm = op2 & 0xFFF;
+    in->flags |= INSN_IMM | INSN_INDEX | ((op1 & 0x80) ? INSN_ADD : 0);
+  } else if (op1 & 0x80) { /* imm12 */
+    in->imm = op2 & 0xFFF;
+    in->flags |= INSN_IMM | INSN_INDEX | INSN_ADD;
+  } else if ((op2 & 0x0FC0) == 0) { /* register */
+    in->rm = op2 & 0xF;
+    imm_shift(in, 0, (op2 >> 4) & 3);
+    in->flags |= INSN_INDEX | INSN_ADD;
+  } else if (op2 & 0x0800) { /* imm8, pre/post indexed */
+    in->imm = op2 & 0xFF;
+    in->flags |= INSN_IMM;
+    if (op2 & 0x0400) in->flags |= INSN_INDEX;
+    if (op2 & 0x0200) in->flags |= INSN_ADD;
+    if (op2 & 0x0100) in->flags |= INSN_WBACK;
+    if (!(in->flags & (INSN_INDEX | INSN_WBACK))) in->op = insn_undefined;
+  } else {
+    in->op = insn_undefined;
+    return;
+  }
+  /* preload hints */
+  if (load && in->rd == PC && size != 2) in->op = insn_nop;
+}
+
+static void decode32(uint16_t op1, uint16_t op2, insn_t *in) {
+  in->flags = INSN_V7;
+
+  if ((op1 & 0xF800) == 0xE800) {
+    if ((op1 & 0xFE40) == 0xE800) { /* load/store multiple */
+      unsigned int mode = (op1 >> 7) & 3;
+      if (mode != 1 && mode != 2) return;
+      in->op = (op1 & 0x10) ? insn_ldm : insn_stm;
+      in->rn = op1 & 0xF;
+      in->list = op2;
+      if (mode == 2) in->flags |= INSN_DB;
+      if (op1 & 0x20) in->flags |= INSN_WBACK;
+    } else if ((op1 & 0xFE40) == 0xE840) {
+      if ((op1 & 0xFFF0) == 0xE8D0 && (op2 & 0xFFE0) == 0xF000) { /* TBB, TBH */
+        in->op = (op2 & 0x10) ? insn_tbh : insn_tbb;
+        in->rn = op1 & 0xF;
+        in->rm = op2 & 0xF;
+      } else if (op1 & 0x0120) { /* LDRD, STRD */
+        in->op = (op1 & 0x10) ? insn_ldrd : insn_strd;
+        in->rn = op1 & 0xF;
+        in->rd = op2 >> 12;
+        in->ra = (op2 >> 8) & 0xF;
+        in->imm = (op2 & 0xFF) << 2;
+        in->flags |= INSN_IMM;
+        if (op1 & 0x0100) in->flags |= INSN_INDEX;
+        if (op1 & 0x0080) in->flags |= INSN_ADD;
+        if (op1 & 0x0020) in->flags |= INSN_WBACK;
+      }
+    } else if ((op1 & 0xFE00) == 0xEA00) { /* data processing (shifted register) */
+      in->rn = op1 & 0xF;
+      in->rd = (op2 >> 8) & 0xF;
+      in->rm = op2 & 0xF;
+      imm_shift(in, (op2 >> 4) & 3, ((op2 >> 10) & 0x1C) | ((op2 >> 6) & 3));
+      dp32(in, (op1 >> 5) & 0xF, (op1 >> 4) & 1);
+    }
+    return;
+  }
+
+  if ((op1 & 0xF800) == 0xF000) {
+    if ((op2 & 0x8000) == 0) {
+      in->rn = op1 & 0xF;
+      in->rd = (op2 >> 8) & 0xF;
+      uint32_t imm12 = ((op1 & 0x0400) << 1) | ((op2 >> 4) & 0x0700) | (op2 & 0xFF);
+      if ((op1 & 0x0200) == 0) { /* data processing (modified immediate) */
+        in->imm = thumb32_expand_imm(imm12);
+        in->carry = (imm12 >> 10) ? (in->imm >> 31) : INSN_CARRY_NONE;
+        in->flags |= INSN_IMM;
+        dp32(in, (op1 >> 5) & 0xF, (op1 >> 4) & 1);
+        return;
+      }
+      /* data processing (plain binary immediate) */
+      unsigned int lsb = ((op2 >> 10) & 0x1C) | ((op2 >> 6) & 3);
+      switch ((op1 >> 4) & 0x1F) {
+      case 0x00: case 0x0A: /* ADDW, SUBW, ADR */
+        in->op = (op1 & 0x00A0) ? insn_sub : insn_add;
+        in->imm = imm12;
+        in->flags |= INSN_IMM;
+        if (in->rn == PC) {
+          in->flags |= in->op == insn_add ? INSN_ADD : 0;
+          in->op = insn_adr;
+        }
+        break;
+      case 0x04: case 0x0C: /* MOVW, MOVT */
+        in->op = (op1 & 0x80) ? insn_movt : insn_mov;
+        in->imm = ((op1 & 0xF) << 12) | imm12;
+        in->flags |= INSN_IMM;
+        break;
+      case 0x14: case 0x1C: /* SBFX, UBFX */
+        in->op = (op1 & 0x80) ? insn_ubfx : insn_sbfx;
+        in->amount = lsb;
+        in->imm = (op2 & 0x1F) + 1;
+        break;
+      case 0x16: /* BFI, BFC */
+        in->op = in->rn == PC ? insn_bfc : insn_bfi;
+        in->amount = lsb;
+        in->imm = op2 & 0x1F;
+        if (in->imm < lsb) in->op = insn_undefined;
+        break;
+      default:
+        break;
+      }
+      return;
+    }
+
+    /* branches and miscellaneous control */
+    uint32_t s = (op1 >> 10) & 1;
+    uint32_t j1 = (op2 >> 13) & 1;
+    uint32_t j2 = (op2 >> 11) & 1;
+    switch (op2 & 0x5000) {
+    case 0x0000:
+      if ((op1 & 0x0380) != 0x0380) { /* B<c>.W */
+        in->op = insn_b;
+        in->cond = (op1 >> 6) & 0xF;
+        in->imm = (uint32_t)sign_extend((s << 20) | (j2 << 19) | (j1 << 18) |
+                                        ((op1 & 0x3F) << 12) | ((op2 & 0x7FF) << 1), 21);
+      } else if ((op1 & 0xFFE0) == 0xF380 && (op2 & 0xFF00) == 0x8800) {
+        in->op = insn_msr;
+        in->rn = op1 & 0xF;
+        in->imm = op2 & 0xFF;
+        in->flags = 0;
+      } else if (op1 == 0xF3EF && (op2 & 0xF000) == 0x8000) {
+        in->op = insn_mrs;
+        in->rd = (op2 >> 8) & 0xF;
+        in->imm = op2 & 0xFF;
+        in->flags = 0;
+      } else if (op1 == 0xF3BF && (op2 & 0xFF00) == 0x8F00) {
+        unsigned int o = (op2 >> 4) & 0xF;
+        if (o == 2 || o == 4 || o == 5 || o == 6) { /* CLREX, DSB, DMB, ISB */
+          in->op = insn_barrier;
+          in->imm = op2 & 0xFF;
+          if (o != 2) in->flags = 0;
+        }
+      } else if (op1 == 0xF3AF && (op2 & 0xFF00) == 0x8000) {
+        in->op = insn_nop; /* NOP.W and other hints */
+        in->imm = op2 & 0xFF;
+      }
+      return;
+    case 0x1000: case 0x5000: { /* B.W, BL */
+      uint32_t i1 = !(j1 ^ s);
+      uint32_t i2 = !(j2 ^ s);
+      in->op = (op2 & 0x4000) ? insn_bl : insn_b;
+      in->imm = (uint32_t)sign_extend((s << 24) | (i1 << 23) | (i2 << 22) |
+                                      ((op1 & 0x3FF) << 12) | ((op2 & 0x7FF) << 1), 25);
+      if (in->op == insn_bl) in->flags = 0;
+      return;
+    }
+    default:
+      return;
+    }
+  }
+
+  /* 11111 */
+  if ((op1 & 0xFE00) == 0xF800) {
+    load_store32(op1, op2, in);
+    return;
+  }
+
+  in->rn = op1 & 0xF;
+  in->rd = (op2 >> 8) & 0xF;
+  in->rm = op2 & 0xF;
+
+  if ((op1 & 0xFF80) == 0xFA00 && (op2 & 0xF0F0) == 0xF000) { /* shift by register */
+    static const uint8_t ops[4] = {insn_lsl, insn_lsr, insn_asr, insn_ror};
+    in->op = ops[(op1 >> 5) & 3];
+    if (op1 & 0x10) in->flags |= INSN_S;
+  } else if ((op1 & 0xFF80) == 0xFA00 && (op2 & 0xF0C0) == 0xF080) { /* extend */
+    static const uint8_t ops[8] = {insn_sxth, insn_uxth, insn_undefined, insn_undefined,
+                                   insn_sxtb, insn_uxtb, insn_undefined, insn_undefined};
+    if (in->rn == PC) in->op = ops[(op1 >> 4) & 7];
+    in->amount = ((op2 >> 4) & 3) << 3;
+  } else if ((op1 & 0xFFF0) == 0xFA90 && (op2 & 0xF0C0) == 0xF080) {
+    static const uint8_t ops[4] = {insn_rev, insn_rev16, insn_rbit, insn_revsh};
+    in->op = ops[(op2 >> 4) & 3];
+  } else if ((op1 & 0xFFF0) == 0xFAB0 && (op2 & 0xF0F0) == 0xF080) {
+    in->op = insn_clz;
+  } else if ((op1 & 0xFFF0) == 0xFB00 && (op2 & 0x00E0) == 0) {
+    in->ra = op2 >> 12;
+    if (op2 & 0x10) in->op = insn_mls;
+    else in->op = in->ra == PC ? insn_mul : insn_mla;
+  } else if ((op1 & 0xFF90) == 0xFB80 && (op2 & 0xF0) == 0) {
+    static const uint8_t ops[4] = {insn_smull, insn_umull, insn_smlal, insn_umlal};
+    in->op = ops[(op1 >> 5) & 3];
+    in->rd = op2 >> 12;
+    in->ra = (op2 >> 8) & 0xF;
+  } else if ((op1 & 0xFFD0) == 0xFB90 && (op2 & 0xF0) == 0xF0) {
+    in->op = (op1 & 0x20) ? insn_udiv : insn_sdiv;
+  }
+}
+
+unsigned int decode(const uint16_t *hw, unsigned int n, bool in_it, insn_t *out) {
+  if (n == 0) return 0;
+
+  memset(out, 0, sizeof(insn_t));
+  out->cond = cond_al;
+  out->shift = imm_shift_none;
+  out->carry = INSN_CARRY_NONE;
+
+  uint16_t op = hw[0];
+  if ((op >> 11) < 29) {
+    out->size = 1;
+    decode16(op, in_it, out);
+  } else {
+    if (n < 2) return 0;
+    out->size = 2;
+    decode32(op, hw[1], out);
+  }
+  return out->size;
+}
+
+bool insn_is_branch(const insn_t *in) {
+  switch (in->op) {
+  case insn_b: case insn_bl: case insn_bx: case insn_blx:
+  case insn_cbz: case insn_cbnz: case insn_tbb: case insn_tbh:
+  case insn_svc: case insn_bkpt: case insn_udf: case insn_undefined:
+    return true;
+  case insn_ldm:
+    return (in->list >> PC) & 1;
+  case insn_ldr:
+    return in->rd == PC;
+  case insn_add: case insn_mov:
+    return in->rd == PC && !(in->flags & INSN_S);
+  default:
+    return false;
+  }
+}
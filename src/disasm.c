@@ -0,0 +1,656 @@
+
+#include <disasm.h>
+#include <labels.h>
+
+#include <string.h>
+
+typedef struct {
+  char *p;
+  char *end;  /* room for the terminating zero is kept */
+} out_t;
+
+static const char *reg_names[16] = {
+  "r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7",
+  "r8", "r9", "r10", "r11", "r12", "sp", "lr", "pc"};
+
+static const char *cond_names[16] = {
+  "eq", "ne", "cs", "cc", "mi", "pl", "vs", "vc",
+  "hi", "ls", "ge", "lt", "gt", "le", "", ""};
+
+static const char *shift_names[6] = {"lsl", "lsr", "asr", "rrx", "ror", ""};
+
+static const char *names[insn_count] = {
+  [insn_undefined] = "<undefined>",
+  [insn_and] = "and", [insn_eor] = "eor", [insn_orr] = "orr", [insn_orn] = "orn",
+  [insn_bic] = "bic", [insn_mov] = "mov", [insn_mvn] = "mvn",
+  [insn_add] = "add", [insn_adc] = "adc", [insn_sub] = "sub", [insn_sbc] = "sbc",
+  [insn_rsb] = "rsb",
+  [insn_tst] = "tst", [insn_teq] = "teq", [insn_cmp] = "cmp", [insn_cmn] = "cmn",
+  [insn_lsl] = "lsl", [insn_lsr] = "lsr", [insn_asr] = "asr", [insn_ror] = "ror",
+  [insn_mul] = "mul", [insn_mla] = "mla", [insn_mls] = "mls",
+  [insn_smull] = "smull", [insn_umull] = "umull", [insn_smlal] = "smlal", [insn_umlal] = "umlal",
+  [insn_sdiv] = "sdiv", [insn_udiv] = "udiv",
+  [insn_clz] = "clz", [insn_rev] = "rev", [insn_rev16] = "rev16", [insn_revsh] = "revsh",
+  [insn_rbit] = "rbit",
+  [insn_sxtb] = "sxtb", [insn_sxth] = "sxth", [insn_uxtb] = "uxtb", [insn_uxth] = "uxth",
+  [insn_movt] = "movt", [insn_bfi] = "bfi", [insn_bfc] = "bfc",
+  [insn_sbfx] = "sbfx", [insn_ubfx] = "ubfx",
+  [insn_adr] = "adr",
+  [insn_ldr] = "ldr", [insn_ldrb] = "ldrb", [insn_ldrh] = "ldrh",
+  [insn_ldrsb] = "ldrsb", [insn_ldrsh] = "ldrsh",
+  [insn_str] = "str", [insn_strb] = "strb", [insn_strh] = "strh",
+  [insn_ldrd] = "ldrd", [insn_strd] = "strd",
+  [insn_ldm] = "ldm", [insn_stm] = "stm",
+  [insn_b] = "b", [insn_bl] = "bl", [insn_bx] = "bx", [insn_blx] = "blx",
+  [insn_cbz] = "cbz", [insn_cbnz] = "cbnz", [insn_tbb] = "tbb", [insn_tbh] = "tbh",
+  [insn_it] = "it",
+  [insn_svc] = "svc", [insn_bkpt] = "bkpt", [insn_udf] = "udf",
+  [insn_nop] = "nop", [insn_barrier] = "dsb", [insn_mrs] = "mrs", [insn_msr] = "msr",
+  [insn_cps] = "cps",
+};
+
+/* Output */
+
+static inline void put_c(out_t *o, char c) {
+  if (o->p < o->end) *o->p++ = c;
+}
+
+static inline void put_s(out_t *o, const char *s) {
+  while (*s) put_c(o, *s++);
+}
+
+static void put_dec(out_t *o, uint32_t v) {
+  char t[10];
+  unsigned int n = 0;
+  do {
+    t[n++] = (char)('0' + v % 10);
+    v /= 10;
+  } while (v);
+  while (n) put_c(o, t[--n]);
+}
+
+static void put_hex(out_t *o, uint32_t v, unsigned int digits) {
+  static const char hex[] = "0123456789abcdef";
+  char t[8];
+  unsigned int n = 0;
+  do {
+    t[n++] = hex[v & 0xF];
+    v >>= 4;
+  } while (v || n < digits);
+  while (n) put_c(o, t[--n]);
+}
+
+static void put_addr(out_t *o, uint32_t a) {
+  put_s(o, "0x");
+  put_hex(o, a, 8);
+}
+
+/* Immediates in decimal when small, else hex */
+static void put_imm(out_t *o, uint32_t v) {
+  put_c(o, '#');
+  if (v < 256) {
+    put_dec(o, v);
+  } else {
+    put_s(o, "0x");
+    put_hex(o, v, 1);
+  }
+}
+
+static inline void put_reg(out_t *o, unsigned int r) {
+  put_s(o, reg_names[r & 15]);
+}
+
+static inline void put_sep(out_t *o) {
+  put_s(o, ", ");
+}
+
+static void put_regs(out_t *o, unsigned int a, unsigned int b) {
+  put_reg(o, a);
+  put_sep(o);
+  put_reg(o, b);
+}
+
+static void put_list(out_t *o, uint16_t list) {
+  bool first = true;
+  put_c(o, '{');
+  for (unsigned int r = 0; r < 16; r ++) {
+    if (!((list >> r) & 1)) continue;
+    if (!first) put_sep(o);
+    put_reg(o, r);
+    first = false;
+  }
+  put_c(o, '}');
+}
+
+/* Mnemonic with the S and condition suffixes */
+static void put_mnem(out_t *o, const char *name, const insn_t *in) {
+  put_s(o, name);
+  if (in->flags & INSN_S) put_c(o, 's');
+  put_s(o, cond_names[in->cond & 15]);
+}
+
+/* Operand 2: #imm or rm with its shift */
+static void put_op2(out_t *o, const insn_t *in) {
+  if (in->flags & INSN_IMM) {
+    put_imm(o, in->imm);
+    return;
+  }
+  put_reg(o, in->rm);
+  if (in->shift == imm_shift_none) return;
+  put_sep(o);
+  put_s(o, shift_names[in->shift]);
+  if (in->shift != imm_shift_rrx) {
+    put_c(o, ' ');
+    put_imm(o, in->amount);
+  }
+}
+
+static void put_address(out_t *o, const insn_t *in) {
+  put_c(o, '[');
+  put_reg(o, in->rn);
+  if (!(in->flags & INSN_IMM)) {
+    put_sep(o);
+    put_reg(o, in->rm);
+    if (in->shift == imm_shift_lsl) {
+      put_s(o, ", lsl ");
+      put_imm(o, in->amount);
+    }
+    put_c(o, ']');
+    return;
+  }
+  if (!(in->flags & INSN_INDEX)) put_c(o, ']');
+  if (in->imm || !(in->flags & INSN_ADD) || !(in->flags & INSN_INDEX)) {
+    put_sep(o);
+    put_c(o, '#');
+    if (!(in->flags & INSN_ADD)) put_c(o, '-');
+    put_dec(o, in->imm);
+  }
+  if (in->flags & INSN_INDEX) {
+    put_c(o, ']');
+    if (in->flags & INSN_WBACK) put_c(o, '!');
+  }
+}
+
+static const char *sysreg(unsigned int sysm, bool write) {
+  switch (sysm) {
+  case 0:  return write ? "apsr_nzcvq" : "apsr";
+  case 1:  return "iapsr";
+  case 2:  return "eapsr";
+  case 3:  return "xpsr";
+  case 5:  return "ipsr";
+  case 6:  return "epsr";
+  case 7:  return "iepsr";
+  case 8:  return "msp";
+  case 9:  return "psp";
+  case 16: return "primask";
+  case 17: return "basepri";
+  case 18: return "basepri_max";
+  case 19: return "faultmask";
+  case 20: return "control";
+  default: return NULL;
+  }
+}
+
+static void put_sysreg(out_t *o, unsigned int sysm, bool write) {
+  const char *s = sysreg(sysm, write);
+  if (s) put_s(o, s);
+  else put_dec(o, sysm);
+}
+
+static void format(out_t *o, const insn_t *in, uint32_t addr) {
+  uint32_t pc = addr + 4;
+  const char *name = names[in->op];
+
+  switch (in->op) {
+  case insn_undefined:
+    put_s(o, name);
+    return;
+
+  case insn_mov:
+    if (in->flags & INSN_IMM) {
+      if (in->size == 2 && !(in->flags & INSN_S) && thumb32_encode_mod_imm(in->imm) < 0)
+        name = "movw";
+      put_mnem(o, name, in);
+      put_c(o, ' ');
+      put_reg(o, in->rd);
+      put_sep(o);
+      put_imm(o, in->imm);
+    } else if (in->shift == imm_shift_none) {
+      put_mnem(o, name, in);
+      put_c(o, ' ');
+      put_regs(o, in->rd, in->rm);
+    } else {
+      put_mnem(o, shift_names[in->shift], in);
+      put_c(o, ' ');
+      put_regs(o, in->rd, in->rm);
+      if (in->shift != imm_shift_rrx) {
+        put_sep(o);
+        put_imm(o, in->amount);
+      }
+    }
+    return;
+
+  case insn_mvn:
+    put_mnem(o, name, in);
+    put_c(o, ' ');
+    put_reg(o, in->rd);
+    put_sep(o);
+    put_op2(o, in);
+    return;
+
+  case insn_tst: case insn_teq: case insn_cmp: case insn_cmn:
+    put_s(o, name);
+    put_s(o, cond_names[in->cond & 15]);
+    put_c(o, ' ');
+    put_reg(o, in->rn);
+    put_sep(o);
+    put_op2(o, in);
+    return;
+
+  case insn_and: case insn_eor: case insn_orr: case insn_orn: case insn_bic:
+  case insn_add: case insn_adc: case insn_sub: case insn_sbc: case insn_rsb:
+    put_mnem(o, name, in);
+    put_c(o, ' ');
+    put_regs(o, in->rd, in->rn);
+    put_sep(o);
+    put_op2(o, in);
+    return;
+
+  case insn_lsl: case insn_lsr: case insn_asr: case insn_ror:
+  case insn_mul: case insn_sdiv: case insn_udiv:
+    put_mnem(o, name, in);
+    put_c(o, ' ');
+    put_regs(o, in->rd, in->rn);
+    put_sep(o);
+    put_reg(o, in->rm);
+    return;
+
+  case insn_mla: case insn_mls:
+    put_mnem(o, name, in);
+    put_c(o, ' ');
+    put_regs(o, in->rd, in->rn);
+    put_sep(o);
+    put_regs(o, in->rm, in->ra);
+    return;
+
+  case insn_smull: case insn_umull: case insn_smlal: case insn_umlal:
+    put_mnem(o, name, in);
+    put_c(o, ' ');
+    put_regs(o, in->rd, in->ra);
+    put_sep(o);
+    put_regs(o, in->rn, in->rm);
+    return;
+
+  case insn_clz: case insn_rev: case insn_rev16: case insn_revsh: case insn_rbit:
+    put_mnem(o, name, in);
+    put_c(o, ' ');
+    put_regs(o, in->rd, in->rm);
+    return;
+
+  case insn_sxtb: case insn_sxth: case insn_uxtb: case insn_uxth:
+    put_mnem(o, name, in);
+    put_c(o, ' ');
+    put_regs(o, in->rd, in->rm);
+    if (in->amount) {
+      put_s(o, ", ror ");
+      put_imm(o, in->amount);
+    }
+    return;
+
+  case insn_movt:
+    put_mnem(o, name, in);
+    put_c(o, ' ');
+    put_reg(o, in->rd);
+    put_sep(o);
+    put_imm(o, in->imm);
+    return;
+
+  case insn_bfi: case insn_bfc: case insn_sbfx: case insn_ubfx:
+    put_mnem(o, name, in);
+    put_c(o, ' ');
+    put_reg(o, in->rd);
+    if (in->op != insn_bfc) {
+      put_sep(o);
+      put_reg(o, in->rn);
+    }
+    put_sep(o);
+    put_imm(o, in->amount);
+    put_sep(o);
+    /* imm is msb for BFI/BFC and the width for SBFX/UBFX */
+    put_imm(o, in->op == insn_bfi || in->op == insn_bfc ? in->imm - in->amount + 1 : in->imm);
+    return;
+
+  case insn_adr: {
+    uint32_t base = pc & ~3u;
+    put_mnem(o, name, in);
+    put_c(o, ' ');
+    put_reg(o, in->rd);
+    put_sep(o);
+    put_addr(o, (in->flags & INSN_ADD) ? base + in->imm : base - in->imm);
+    return;
+  }
+
+  case insn_ldr: case insn_ldrb: case insn_ldrh: case insn_ldrsb: case insn_ldrsh:
+  case insn_str: case insn_strb: case insn_strh:
+    put_mnem(o, name, in);
+    put_c(o, ' ');
+    put_reg(o, in->rd);
+    put_sep(o);
+    put_address(o, in);
+    return;
+
+  case insn_ldrd: case insn_strd:
+    put_mnem(o, name, in);
+    put_c(o, ' ');
+    put_regs(o, in->rd, in->ra);
+    put_sep(o);
+    put_address(o, in);
+    return;
+
+  case insn_ldm: case insn_stm:
+    if (in->rn == SP && (in->flags & INSN_WBACK) &&
+	(in->op == insn_ldm) == !(in->flags & INSN_DB)) {
+      put_mnem(o, in->op == insn_ldm ? "pop" : "push", in);
+      put_c(o, ' ');
+    } else {
+      put_s(o, name);
+      if (in->flags & INSN_DB) put_s(o, "db");
+      put_s(o, cond_names[in->cond & 15]);
+      put_c(o, ' ');
+      put_reg(o, in->rn);
+      if (in->flags & INSN_WBACK) put_c(o, '!');
+      put_sep(o);
+    }
+    put_list(o, in->list);
+    return;
+
+  case insn_b:
+    put_mnem(o, name, in);
+    if (in->size == 2) put_s(o, ".w");
+    put_c(o, ' ');
+    put_addr(o, pc + in->imm);
+    return;
+
+  case insn_bl:
+    put_mnem(o, name, in);
+    put_c(o, ' ');
+    put_addr(o, pc + in->imm);
+    return;
+
+  case insn_bx: case insn_blx:
+    put_mnem(o, name, in);
+    put_c(o, ' ');
+    put_reg(o, in->rm);
+    return;
+
+  case insn_cbz: case insn_cbnz:
+    put_s(o, name);
+    put_c(o, ' ');
+    put_reg(o, in->rn);
+    put_sep(o);
+    put_addr(o, pc + in->imm);
+    return;
+
+  case insn_tbb: case insn_tbh:
+    put_mnem(o, name, in);
+    put_s(o, " [");
+    put_regs(o, in->rn, in->rm);
+    if (in->op == insn_tbh) put_s(o, ", lsl #1");
+    put_c(o, ']');
+    return;
+
+  case insn_it: {
+    unsigned int first = (in->imm >> 4) & 0xF;
+    unsigned int mask = in->imm & 0xF;
+    put_s(o, name);
+    for (unsigned int i = 3; i > 0 && (mask & ((1u << i) - 1)); i --)
+      put_c(o, ((mask >> i) & 1) == (first & 1) ? 't' : 'e');
+    put_c(o, ' ');
+    put_s(o, cond_names[first]);
+    return;
+  }
+
+  case insn_svc: case insn_bkpt: case insn_udf:
+    put_mnem(o, name, in);
+    put_c(o, ' ');
+    put_imm(o, in->imm);
+    return;
+
+  case insn_nop: {
+    static const char *hints[5] = {"nop", "yield", "wfe", "wfi", "sev"};
+    if (in->flags & (INSN_IMM | INSN_INDEX)) { /* PLD, PLI */
+      put_mnem(o, "pld", in);
+      put_c(o, ' ');
+      put_address(o, in);
+      return;
+    }
+    put_mnem(o, in->imm < 5 ? hints[in->imm] : name, in);
+    if (in->size == 2) put_s(o, ".w");
+    return;
+  }
+
+  case insn_barrier: {
+    static const char *barriers[16] = {
+      [2] = "clrex", [4] = "dsb", [5] = "dmb", [6] = "isb"};
+    const char *b = barriers[(in->imm >> 4) & 0xF];
+    put_mnem(o, b ? b : name, in);
+    if (((in->imm >> 4) & 0xF) == 2) return;
+    put_c(o, ' ');
+    if ((in->imm & 0xF) == 0xF) put_s(o, "sy");
+    else put_imm(o, in->imm & 0xF);
+    return;
+  }
+
+  case insn_mrs:
+    put_mnem(o, name, in);
+    put_c(o, ' ');
+    put_reg(o, in->rd);
+    put_sep(o);
+    put_sysreg(o, in->imm, false);
+    return;
+
+  case insn_msr:
+    put_mnem(o, name, in);
+    put_c(o, ' ');
+    put_sysreg(o, in->imm, true);
+    put_sep(o);
+    put_reg(o, in->rn);
+    return;
+
+  case insn_cps:
+    put_s(o, (in->imm & 0x10) ? "cpsid " : "cpsie ");
+    if (in->imm & 2) put_c(o, 'i');
+    if (in->imm & 1) put_c(o, 'f');
+    return;
+
+  default:
+    put_s(o, name);
+    return;
+  }
+}
+
+unsigned int disasm_insn(const insn_t *in, uint32_t addr, char *buf, unsigned int size) {
+  if (size == 0) return 0;
+  out_t o = {buf, buf + size - 1};
+  format(&o, in, addr);
+  *o.p = 0;
+  return (unsigned int)(o.p - buf);
+}
+
+/* Halfwords that do not decode */
+static void format_raw(out_t *o, const uint16_t *hw, unsigned int size) {
+  if (size == 2) {
+    put_s(o, ".inst.w 0x");
+    put_hex(o, hw[0], 4);
+    put_hex(o, hw[1], 4);
+  } else {
+    put_s(o, ".short 0x");
+    put_hex(o, hw[0], 4);
+  }
+}
+
+unsigned int disasm(const uint16_t *hw, unsigned int n, uint32_t addr,
+		    char *buf, unsigned int size) {
+  insn_t in;
+  unsigned int len = decode(hw, n, false, &in);
+  if (!len || size == 0) return 0;
+  out_t o = {buf, buf + size - 1};
+  if (in.op == insn_undefined) format_raw(&o, hw, len);
+  else format(&o, &in, addr);
+  *o.p = 0;
+  return len;
+}
+
+/* Listing */
+
+static inline uint16_t *chunk_at(instr_chunk_t **c, unsigned int offset) {
+  while (*c && offset >= (*c)->start + (*c)->used) *c = (*c)->next;
+  return *c ? &(*c)->mc[offset - (*c)->start] : NULL;
+}
+
+static void put_label(out_t *o, int32_t l) {
+  put_c(o, 'L');
+  put_dec(o, (uint32_t)l);
+}
+
+static void put_target_label(out_t *o, const int32_t *label_at, uint32_t target,
+			     uint32_t base, unsigned int n) {
+  if (!label_at || target < base || ((target - base) & 1)) return;
+  uint32_t off = (target - base) / 2;
+  if (off > n || label_at[off] < 0) return;
+  put_s(o, " <");
+  put_label(o, label_at[off]);
+  put_c(o, '>');
+}
+
+int disasm_seq(instr_seq_t *seq, uint32_t base, disasm_line_fn fn, void *user) {
+  unsigned int n = seq_length(seq);
+  fixup_table_t *t = seq->fix;
+  int32_t *label_at = NULL;
+  uint8_t *data = NULL;
+
+  if (t) {
+    label_at = seq->alloc((n + 1) * sizeof(int32_t));
+    data = seq->alloc(n + 1);
+    if (!label_at || !data) {
+      if (label_at) seq->free(label_at);
+      if (data) seq->free(data);
+      return 0;
+    }
+    for (unsigned int i = 0; i <= n; i ++) label_at[i] = -1;
+    memset(data, 0, n + 1);
+    for (int32_t l = (int32_t)t->n_labels - 1; l >= 0; l --) {
+      unsigned int off = t->labels[l].offset;
+      if (off <= n) label_at[off] = l;
+    }
+    for (unsigned int i = 0; i < t->n_data; i ++) {
+      for (unsigned int j = 0; j < t->data[i].size; j ++) {
+	unsigned int off = t->data[i].offset + j;
+	if (off < n) data[off] = 1;
+      }
+    }
+  }
+
+  char line[DISASM_LINE];
+  out_t o;
+  instr_chunk_t *c = seq_chunks(seq);
+  uint8_t it = 0;
+  unsigned int off = 0;
+  while (off <= n) {
+    if (label_at && label_at[off] >= 0) {
+      o = (out_t){line, line + sizeof(line) - 1};
+      put_label(&o, label_at[off]);
+      put_c(&o, ':');
+      *o.p = 0;
+      fn(user, line);
+    }
+    if (off == n) break;
+
+    uint32_t addr = base + off * 2;
+    uint16_t hw[2];
+    unsigned int avail = 1;
+    hw[0] = *chunk_at(&c, off);
+    if (off + 1 < n && !(data && data[off + 1] != data[off])) {
+      hw[1] = *chunk_at(&c, off + 1);
+      avail = 2;
+    }
+
+    o = (out_t){line, line + sizeof(line) - 1};
+    put_hex(&o, addr, 8);
+    put_s(&o, ":  ");
+
+    if (data && data[off]) {
+      bool word = avail == 2;
+      put_hex(&o, hw[0], 4);
+      if (word) {
+	put_c(&o, ' ');
+	put_hex(&o, hw[1], 4);
+	put_s(&o, "  .word 0x");
+	put_hex(&o, hw[0] | ((uint32_t)hw[1] << 16), 8);
+      } else {
+	put_s(&o, "       .short 0x");
+	put_hex(&o, hw[0], 4);
+      }
+      *o.p = 0;
+      fn(user, line);
+      off += word ? 2 : 1;
+      it = 0;
+      continue;
+    }
+
+    insn_t in;
+    unsigned int size = decode(hw, avail, it != 0, &in);
+    if (!size) {
+      size = 1;
+      in.op = insn_undefined;
+    }
+    put_hex(&o, hw[0], 4);
+    if (size == 2) {
+      put_c(&o, ' ');
+      put_hex(&o, hw[1], 4);
+    } else {
+      put_s(&o, "     ");
+    }
+    put_s(&o, "  ");
+
+    if (it) {
+      in.cond = it >> 4;
+      it = (it & 7) == 0 ? 0 : (it & 0xE0) | ((it << 1) & 0x1F);
+    } else if (in.op == insn_it) {
+      it = (uint8_t)in.imm;
+    }
+
+    if (in.op == insn_undefined) {
+      format_raw(&o, hw, size);
+    } else {
+      format(&o, &in, addr);
+      switch (in.op) {
+      case insn_b: case insn_bl: case insn_cbz: case insn_cbnz:
+	put_target_label(&o, label_at, addr + 4 + in.imm, base, n);
+	break;
+      case insn_ldr: case insn_ldrb: case insn_ldrh: case insn_ldrsb: case insn_ldrsh:
+	if (in.rn == PC && (in.flags & INSN_IMM)) {
+	  uint32_t a = ((addr + 4) & ~3u);
+	  a = (in.flags & INSN_ADD) ? a + in.imm : a - in.imm;
+	  put_s(&o, "  ; ");
+	  put_addr(&o, a);
+	  uint32_t lo = (a - base) / 2;
+	  if (a >= base && in.op == insn_ldr && lo + 1 < n) {
+	    put_s(&o, " = ");
+	    put_addr(&o, *seq_at(seq, lo) | ((uint32_t)*seq_at(seq, lo + 1) << 16));
+	  }
+	}
+	break;
+      default:
+	break;
+      }
+    }
+    *o.p = 0;
+    fn(user, line);
+    off += size;
+  }
+
+  if (label_at) seq->free(label_at);
+  if (data) seq->free(data);
+  return 1;
+}
@@ -0,0 +1,457 @@
+/**********************************************************************************/
+/* MIT License									  */
+/* 										  */
+/* Copyright (c) 2020 Joel Svensson             				  */
+/* 										  */
+/* Permission is hereby granted, free of charge, to any person obtaining a copy	  */
+/* of this software and associated documentation files (the "Software"), to deal  */
+/* in the Software without restriction, including without limitation the rights	  */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell	  */
+/* copies of the Software, and to permit persons to whom the Software is	  */
+/* furnished to do so, subject to the following conditions:			  */
+/* 										  */
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software.				  */
+/* 										  */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR	  */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,	  */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE	  */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER	  */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,  */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE  */
+/* SOFTWARE.									  */
+/**********************************************************************************/
+
+#include <labels.h>
+#include <literals.h>
+
+#include <string.h>
+
+static thumb_opcode_t (*const bcond16[])(uint8_t) =
+  { m0_beq_imm8, m0_bne_imm8, m0_bcs_imm8, m0_bcc_imm8,
+    m0_bmi_imm8, m0_bpl_imm8, m0_bvs_imm8, m0_bvc_imm8,
+    m0_bhi_imm8, m0_bls_imm8, m0_bge_imm8, m0_blt_imm8,
+    m0_bgt_imm8, m0_ble_imm8 };
+
+static thumb_opcode_t (*const bcond32[])(int32_t) =
+  { m3_beq, m3_bne, m3_bcs, m3_bcc,
+    m3_bmi, m3_bpl, m3_bvs, m3_bvc,
+    m3_bhi, m3_bls, m3_bge, m3_blt,
+    m3_bgt, m3_ble };
+
+/* ************************************************************
+   Tables
+   ************************************************************ */
+
+static void *grow(instr_seq_t *seq, void *arr, unsigned int n,
+		  unsigned int *cap, size_t elem) {
+  if (n < *cap) return arr;
+  unsigned int new_cap = *cap ? *cap * 2 : 16;
+  void *p = seq->alloc(new_cap * elem);
+  if (!p) return NULL;
+  if (arr) {
+    memcpy(p, arr, n * elem);
+    seq->free(arr);
+  }
+  *cap = new_cap;
+  return p;
+}
+
+fixup_table_t *fixups_get(instr_seq_t *seq) {
+  if (seq->fix) return seq->fix;
+  fixup_table_t *t = seq->alloc(sizeof(fixup_table_t));
+  if (!t) return NULL;
+  memset(t, 0, sizeof(fixup_table_t));
+  seq->fix = t;
+  return t;
+}
+
+void fixups_free(instr_seq_t *seq) {
+  fixup_table_t *t = seq->fix;
+  if (!t) return;
+  if (t->labels) seq->free(t->labels);
+  if (t->fixups) seq->free(t->fixups);
+  if (t->data) seq->free(t->data);
+  lit_pool_free(seq);
+  seq->free(t);
+  seq->fix = NULL;
+}
+
+static fixup_t *add_fixup(instr_seq_t *seq, fixup_t f) {
+  fixup_table_t *t = seq->fix;
+  fixup_t *arr = grow(seq, t->fixups, t->n_fixups, &t->fixups_size, sizeof(fixup_t));
+  if (!arr) return NULL;
+  t->fixups = arr;
+  t->fixups[t->n_fixups] = f;
+  return &t->fixups[t->n_fixups++];
+}
+
+label_t label_new(instr_seq_t *seq) {
+  fixup_table_t *t = fixups_get(seq);
+  if (!t) return LABEL_NONE;
+  label_info_t *arr = grow(seq, t->labels, t->n_labels, &t->labels_size, sizeof(label_info_t));
+  if (!arr) return LABEL_NONE;
+  t->labels = arr;
+  t->labels[t->n_labels].offset  = LABEL_UNBOUND;
+  t->labels[t->n_labels].nfix    = 0;
+  t->labels[t->n_labels].waiting = -1;
+  return (label_t)t->n_labels++;
+}
+
+static bool valid_label(fixup_table_t *t, label_t l) {
+  return t && l >= 0 && (unsigned int)l < t->n_labels;
+}
+
+unsigned int label_offset(instr_seq_t *seq, label_t l) {
+  if (!valid_label(seq->fix, l)) return LABEL_UNBOUND;
+  return seq->fix->labels[l].offset;
+}
+
+/* ************************************************************
+   Encodings
+   ************************************************************ */
+
+static bool fits(int32_t dist, unsigned int bits) {
+  return dist >= -(1 << (bits - 1)) && dist < (1 << (bits - 1));
+}
+
+/* byte displacement from PC for an instruction at offset to target
+   (both in halfwords) */
+static int32_t displacement(unsigned int offset, unsigned int target) {
+  return ((int32_t)target - (int32_t)offset) * 2 - 4;
+}
+
+/* LDR (literal) addresses words from Align(PC, 4) */
+static int32_t literal_displacement(unsigned int offset, unsigned int target) {
+  return (int32_t)target * 2 - (((int32_t)offset * 2 + 4) & ~3);
+}
+
+/* Halfwords needed by f at offset to reach target, 0 if nothing reaches */
+static unsigned int fixup_need(instr_seq_t *seq, fixup_t *f,
+			       unsigned int offset, unsigned int target) {
+  bool thumb2 = TARGET_HAS_THUMB2(seq->target);
+  int32_t dist = displacement(offset, target);
+
+  switch (f->kind) {
+  case fixup_align:
+    return offset & 1;
+  case fixup_literal:
+    dist = literal_displacement(offset, target);
+    return (dist >= 0 && dist <= 1020 && (dist & 3) == 0) ? 1 : 0;
+  case fixup_bl:
+    return fits(dist, 25) ? 2 : 0;
+  }
+
+  if (f->cond == cond_al) {
+    if (fits(dist, 12)) return 1;
+    if (thumb2 && fits(dist, 25)) return 2;
+    return 0;
+  }
+
+  if (fits(dist, 9)) return 1;
+  if (thumb2) return fits(dist, 21) ? 2 : 0;
+  /* M0: B<!c> over an unconditional B placed 2 bytes further on */
+  return fits(dist - 2, 12) ? 2 : 0;
+}
+
+/* Encode f using its reserved size, returns number of ops */
+static int fixup_ops(instr_seq_t *seq, fixup_t *f, unsigned int target, thumb_opcode_t *ops) {
+  int32_t dist = displacement(f->offset, target);
+
+  switch (f->kind) {
+  case fixup_align:
+    ops[0] = m0_nop();
+    return f->size;
+  case fixup_literal:
+    ops[0] = m0_ldr_lit(f->reg, literal_displacement(f->offset, target) >> 2);
+    return 1;
+  case fixup_bl:
+    ops[0] = m0_bl(dist);
+    return 1;
+  }
+
+  if (f->size == 1) {
+    if (f->cond == cond_al)
+      ops[0] = m0_b_imm11((dist >> 1) & IMM11_MASK);
+    else
+      ops[0] = bcond16[f->cond]((dist >> 1) & 0xFF);
+    return 1;
+  }
+  if (f->cond == cond_al) {
+    ops[0] = m3_b(dist);
+    return 1;
+  }
+  if (TARGET_HAS_THUMB2(seq->target)) {
+    ops[0] = bcond32[f->cond](dist);
+    return 1;
+  }
+  ops[0] = bcond16[COND_INVERT(f->cond)](0);
+  ops[1] = m0_b_imm11(((dist - 2) >> 1) & IMM11_MASK);
+  return 2;
+}
+
+static int put_fixup(instr_seq_t *seq, fixup_t *f, unsigned int target) {
+  thumb_opcode_t ops[2];
+  int n = fixup_ops(seq, f, target, ops);
+  unsigned int offset = f->offset;
+  for (int i = 0; i < n; i ++) {
+    if (!emit_opcode_at(seq, offset, ops[i])) return 0;
+    offset += ops[i].kind == thumb32 ? 2 : 1;
+  }
+  return 1;
+}
+
+/* ************************************************************
+   Emitting and binding
+   ************************************************************ */
+
+/* Emit the instruction(s) for f at the current position. f.label may be
+   LABEL_NONE for fixups that do not refer to a label (alignment). */
+int emit_fixup(instr_seq_t *seq, fixup_t f) {
+  fixup_table_t *t = fixups_get(seq);
+  if (!t) return 0;
+
+  label_info_t *l = NULL;
+  if (f.label != LABEL_NONE) {
+    if (!valid_label(t, f.label)) return 0;
+    l = &t->labels[f.label];
+  }
+
+  seq_hold(seq);
+  f.offset = seq_offset(seq);
+  f.next = -1;
+
+  unsigned int target = l ? l->offset : LABEL_UNBOUND;
+  if (!l || target != LABEL_UNBOUND) {
+    f.size = fixup_need(seq, &f, f.offset, target);
+  } else {
+    f.size = f.kind == fixup_bl ? 2 : 1;
+    target = f.offset + 2;
+  }
+
+  int r = 0;
+  thumb_opcode_t ops[2];
+  int n = fixup_ops(seq, &f, target, ops);
+  if (l && f.size == 0) goto done;
+  for (int i = 0; i < n; i ++) {
+    if (!emit_opcode(seq, ops[i])) goto done;
+  }
+
+  fixup_t *p = add_fixup(seq, f);
+  if (!p) goto done;
+  if (l && l->offset == LABEL_UNBOUND) {
+    p->next = l->waiting;
+    l->waiting = (int)(p - t->fixups);
+  }
+  lit_pool_note_fixup(seq, p);
+  r = 1;
+
+ done:
+  seq_release(seq);
+  return r;
+}
+
+int emit_data_word(instr_seq_t *seq, uint32_t value) {
+  fixup_table_t *t = fixups_get(seq);
+  if (!t) return 0;
+
+  thumb_opcode_t op;
+  op.kind = thumb32;
+  /* little endian: low halfword first */
+  op.opcode.thumb32.high = value;
+  op.opcode.thumb32.low  = value >> 16;
+
+  seq_hold(seq);
+  unsigned int offset = seq_offset(seq);
+  int r = emit_opcode(seq, op);
+  if (r) {
+    data_range_t *d = t->n_data ? &t->data[t->n_data - 1] : NULL;
+    if (d && d->offset + d->size == offset && d->nfix == t->n_fixups) {
+      d->size += 2;
+    } else {
+      data_range_t *arr = grow(seq, t->data, t->n_data, &t->data_size, sizeof(data_range_t));
+      if (arr) {
+	t->data = arr;
+	d = &t->data[t->n_data++];
+	d->offset = offset;
+	d->size = 2;
+	d->nfix = t->n_fixups;
+      } else {
+	r = 0;
+      }
+    }
+  }
+  seq_release(seq);
+  return r;
+}
+
+bool seq_is_data(instr_seq_t *seq, unsigned int offset) {
+  fixup_table_t *t = seq->fix;
+  if (!t) return false;
+  for (unsigned int i = 0; i < t->n_data; i ++) {
+    if (offset >= t->data[i].offset && offset < t->data[i].offset + t->data[i].size)
+      return true;
+  }
+  return false;
+}
+
+int emit_branch(instr_seq_t *seq, cond_t cond, label_t l) {
+  fixup_t f = { 0, l, -1, fixup_branch, cond, 0, 0 };
+  return emit_fixup(seq, f);
+}
+
+int emit_bl(instr_seq_t *seq, label_t l) {
+  fixup_t f = { 0, l, -1, fixup_bl, cond_al, 0, 0 };
+  return emit_fixup(seq, f);
+}
+
+int label_bind(instr_seq_t *seq, label_t l) {
+  fixup_table_t *t = seq->fix;
+  if (!valid_label(t, l) || t->labels[l].offset != LABEL_UNBOUND) return 0;
+
+  unsigned int target = seq_offset(seq);
+  t->labels[l].offset = target;
+  t->labels[l].nfix = t->n_fixups;
+
+  int i = t->labels[l].waiting;
+  t->labels[l].waiting = -1;
+  while (i >= 0) {
+    fixup_t *f = &t->fixups[i];
+    unsigned int need = fixup_need(seq, f, f->offset, target);
+    if (need && need <= f->size)
+      put_fixup(seq, f, target);
+    else
+      t->relax++;
+    i = f->next;
+    f->next = -1;
+  }
+  return 1;
+}
+
+/* ************************************************************
+   Relaxation
+   ************************************************************ */
+
+/* Move the code to make room for the resized fixups. grown[i] is the
+   total growth of fixups 0 .. i-1. */
+static int relayout(instr_seq_t *seq, uint8_t *size, int *grown) {
+  fixup_table_t *t = seq->fix;
+  unsigned int n = seq_length(seq);
+  unsigned int m = n + grown[t->n_fixups];
+
+  uint16_t *old = seq->alloc(n * sizeof(uint16_t) + 1);
+  uint16_t *out = seq->alloc(m * sizeof(uint16_t) + 1);
+  if (!old || !out) {
+    if (old) seq->free(old);
+    if (out) seq->free(out);
+    return 0;
+  }
+  seq_flatten(seq, old, n);
+
+  unsigned int src = 0, dst = 0;
+  for (unsigned int i = 0; i < t->n_fixups; i ++) {
+    fixup_t *f = &t->fixups[i];
+    unsigned int len = f->offset - src;
+    memcpy(out + dst, old + src, len * sizeof(uint16_t));
+    dst += len + size[i];
+    src = f->offset + f->size;
+  }
+  memcpy(out + dst, old + src, (n - src) * sizeof(uint16_t));
+
+  for (unsigned int i = 0; i < t->n_labels; i ++) {
+    label_info_t *l = &t->labels[i];
+    if (l->offset != LABEL_UNBOUND)
+      l->offset += grown[l->nfix];
+  }
+  for (unsigned int i = 0; i < t->n_data; i ++) {
+    t->data[i].offset += grown[t->data[i].nfix];
+  }
+  for (unsigned int i = 0; i < t->n_fixups; i ++) {
+    t->fixups[i].offset += grown[i];
+    t->fixups[i].size = size[i];
+  }
+
+  int r = seq_rewrite(seq, out, m);
+  seq->free(old);
+  seq->free(out);
+  return r;
+}
+
+static unsigned int fixup_target(fixup_table_t *t, fixup_t *f, int *grown) {
+  if (f->label == LABEL_NONE) return 0;
+  label_info_t *l = &t->labels[f->label];
+  return l->offset + grown[l->nfix];
+}
+
+/* Resolve all fixups, relaxing branches that do not reach.
+   Returns 0 if a label is unbound or a branch cannot reach its target. */
+int seq_resolve(instr_seq_t *seq) {
+  fixup_table_t *t = seq->fix;
+  if (!t) return 1;
+
+  for (unsigned int i = 0; i < t->n_fixups; i ++) {
+    label_t l = t->fixups[i].label;
+    if (l != LABEL_NONE && t->labels[l].offset == LABEL_UNBOUND) return 0;
+  }
+  if (t->relax == 0) return 1;
+
+  unsigned int n = t->n_fixups;
+  uint8_t *size = seq->alloc(n + 1);
+  int *grown = seq->alloc((n + 1) * sizeof(int));
+  int r = 0;
+  if (!size || !grown) goto done;
+
+  for (unsigned int i = 0; i < n; i ++) size[i] = t->fixups[i].size;
+
+  /* Branches only ever grow and padding only depends on the sizes
+     before it, so this terminates */
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    grown[0] = 0;
+    for (unsigned int i = 0; i < n; i ++) {
+      fixup_t *f = &t->fixups[i];
+      if (f->kind == fixup_align) {
+	unsigned int pad = (f->offset + grown[i]) & 1;
+	if (pad != size[i]) {
+	  size[i] = pad;
+	  changed = true;
+	}
+      }
+      grown[i + 1] = grown[i] + size[i] - f->size;
+    }
+
+    for (unsigned int i = 0; i < n; i ++) {
+      fixup_t *f = &t->fixups[i];
+      if (f->kind == fixup_align) continue;
+      unsigned int need = fixup_need(seq, f, f->offset + grown[i], fixup_target(t, f, grown));
+      if (need > size[i]) {
+	size[i] = need;
+	changed = true;
+      }
+    }
+  }
+
+  for (unsigned int i = 0; i < n; i ++) {
+    fixup_t *f = &t->fixups[i];
+    if (!fixup_need(seq, f, f->offset + grown[i], fixup_target(t, f, grown))
+	&& f->kind != fixup_align) goto done;
+  }
+
+  bool moved = false;
+  for (unsigned int i = 0; i < n; i ++) moved |= size[i] != t->fixups[i].size;
+  if (moved && !relayout(seq, size, grown)) goto done;
+
+  for (unsigned int i = 0; i < n; i ++) {
+    fixup_t *f = &t->fixups[i];
+    unsigned int target = f->label == LABEL_NONE ? 0 : t->labels[f->label].offset;
+    if (!put_fixup(seq, f, target)) goto done;
+  }
+  t->relax = 0;
+  r = 1;
+
+ done:
+  if (size) seq->free(size);
+  if (grown) seq->free(grown);
+  return r;
+}
@@ -0,0 +1,177 @@
+/**********************************************************************************/
+/* MIT License									  */
+/* 										  */
+/* Copyright (c) 2020 Joel Svensson             				  */
+/* 										  */
+/* Permission is hereby granted, free of charge, to any person obtaining a copy	  */
+/* of this software and associated documentation files (the "Software"), to deal  */
+/* in the Software without restriction, including without limitation the rights	  */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell	  */
+/* copies of the Software, and to permit persons to whom the Software is	  */
+/* furnished to do so, subject to the following conditions:			  */
+/* 										  */
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software.				  */
+/* 										  */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR	  */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,	  */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE	  */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER	  */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,  */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE  */
+/* SOFTWARE.									  */
+/**********************************************************************************/
+
+#include <literals.h>
+
+#include <string.h>
+
+/* Halfwords between the mark and the latest safe island position, room
+   for instructions emitted while the sequence is held. */
+#define LIT_MARGIN 16
+
+/* The last pool entry must be within 1020 bytes of Align(PC, 4) of the
+   first load. With the island starting at I, a branch over it and
+   possibly a halfword of padding, entry n-1 is at I + 2 + 2(n-1), which
+   must be at most first_use + 511. */
+#define LIT_REACH 511
+
+static lit_pool_t *pool(instr_seq_t *seq) {
+  fixup_table_t *t = fixups_get(seq);
+  if (!t) return NULL;
+  if (t->pool) return t->pool;
+  lit_pool_t *p = seq->alloc(sizeof(lit_pool_t));
+  if (!p) return NULL;
+  memset(p, 0, sizeof(lit_pool_t));
+  t->pool = p;
+  return p;
+}
+
+void lit_pool_free(instr_seq_t *seq) {
+  lit_pool_t *p = seq->fix ? seq->fix->pool : NULL;
+  if (!p) return;
+  if (p->entries) seq->free(p->entries);
+  seq->free(p);
+  seq->fix->pool = NULL;
+}
+
+unsigned int lit_pool_pending(instr_seq_t *seq) {
+  lit_pool_t *p = seq->fix ? seq->fix->pool : NULL;
+  return p ? p->n : 0;
+}
+
+bool lit_pool_has(instr_seq_t *seq, uint32_t value) {
+  lit_pool_t *p = seq->fix ? seq->fix->pool : NULL;
+  if (!p) return false;
+  for (unsigned int i = 0; i < p->n; i ++) {
+    if (p->entries[i].value == value) return true;
+  }
+  return false;
+}
+
+static unsigned int island_limit(lit_pool_t *p, unsigned int n) {
+  unsigned int need = 2 * n + p->slack + LIT_MARGIN;
+  if (p->first_use + LIT_REACH < need) return 0;
+  return p->first_use + LIT_REACH - need;
+}
+
+static void pool_mark(instr_seq_t *seq) {
+  lit_pool_island(seq);
+}
+
+static int place_pool(instr_seq_t *seq, bool branch_over) {
+  lit_pool_t *p = seq->fix ? seq->fix->pool : NULL;
+  if (!p || p->n == 0) return 1;
+
+  unsigned int n = p->n;
+  p->n = 0;
+  seq_clear_mark(seq);
+  seq_hold(seq);
+
+  int r = 0;
+  label_t over = LABEL_NONE;
+  if (branch_over) {
+    over = label_new(seq);
+    if (!emit_branch(seq, cond_al, over)) goto done;
+  }
+
+  fixup_t align = { 0, LABEL_NONE, -1, fixup_align, 0, 0, 0 };
+  if (!emit_fixup(seq, align)) goto done;
+
+  for (unsigned int i = 0; i < n; i ++) {
+    label_bind(seq, p->entries[i].label);
+    if (!emit_data_word(seq, p->entries[i].value)) goto done;
+  }
+
+  if (branch_over) label_bind(seq, over);
+  r = 1;
+
+ done:
+  seq_release(seq);
+  return r;
+}
+
+/* Place the pending pool here, nothing branches over it */
+int lit_pool_flush(instr_seq_t *seq) {
+  return place_pool(seq, false);
+}
+
+/* Place the pending pool here behind a branch */
+int lit_pool_island(instr_seq_t *seq) {
+  return place_pool(seq, true);
+}
+
+int lit_load(instr_seq_t *seq, reg_t rd, uint32_t value) {
+  if (rd > r7) return 0;
+  lit_pool_t *p = pool(seq);
+  if (!p) return 0;
+
+  lit_entry_t *e = NULL;
+  for (unsigned int i = 0; i < p->n; i ++) {
+    if (p->entries[i].value == value) {
+      e = &p->entries[i];
+      break;
+    }
+  }
+
+  if (!e) {
+    if (p->n > 0 && island_limit(p, p->n + 1) <= seq_offset(seq) + 1) {
+      if (!lit_pool_island(seq)) return 0;
+    }
+    if (p->n == p->size) {
+      unsigned int size = p->size ? p->size * 2 : 16;
+      lit_entry_t *arr = seq->alloc(size * sizeof(lit_entry_t));
+      if (!arr) return 0;
+      if (p->entries) {
+	memcpy(arr, p->entries, p->n * sizeof(lit_entry_t));
+	seq->free(p->entries);
+      }
+      p->entries = arr;
+      p->size = size;
+    }
+    label_t l = label_new(seq);
+    if (l == LABEL_NONE) return 0;
+    if (p->n == 0) {
+      p->first_use = seq_offset(seq);
+      p->slack = 0;
+    }
+    e = &p->entries[p->n++];
+    e->value = value;
+    e->label = l;
+    seq_set_mark(seq, island_limit(p, p->n), pool_mark);
+  }
+
+  fixup_t f = { 0, e->label, -1, fixup_literal, 0, rd, 0 };
+  return emit_fixup(seq, f);
+}
+
+/* Branches emitted after a load from the pending pool may grow when
+   relaxed, which moves the pool further away. Keep room for that. */
+void lit_pool_note_fixup(instr_seq_t *seq, fixup_t *f) {
+  lit_pool_t *p = seq->fix->pool;
+  if (!p || p->n == 0) return;
+  if ((f->kind == fixup_branch || f->kind == fixup_bl) && f->size < 2) {
+    p->slack++;
+    seq_set_mark(seq, island_limit(p, p->n), pool_mark);
+  }
+}
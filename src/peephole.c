@@ -0,0 +1,482 @@
+/**********************************************************************************/
+/* MIT License									  */
+/* 										  */
+/* Copyright (c) 2020 Joel Svensson             				  */
+/* 										  */
+/* Permission is hereby granted, free of charge, to any person obtaining a copy	  */
+/* of this software and associated documentation files (the "Software"), to deal  */
+/* in the Software without restriction, including without limitation the rights	  */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell	  */
+/* copies of the Software, and to permit persons to whom the Software is	  */
+/* furnished to do so, subject to the following conditions:			  */
+/* 										  */
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software.				  */
+/* 										  */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR	  */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,	  */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE	  */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER	  */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,  */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE  */
+/* SOFTWARE.									  */
+/**********************************************************************************/
+
+#include <peephole.h>
+#include <literals.h>
+
+#include <string.h>
+
+#define FLAG_V    1
+#define FLAG_C    2
+#define FLAG_Z    4
+#define FLAG_N    8
+#define FLAGS_NZ  (FLAG_N | FLAG_Z)
+#define FLAGS_NZC (FLAG_N | FLAG_Z | FLAG_C)
+#define FLAGS_CV  (FLAG_C | FLAG_V)
+#define FLAGS_ALL 0xF
+
+/* An instruction, a fixup or a data range of the original code */
+typedef struct {
+  unsigned int offset;
+  unsigned int size;       /* halfwords */
+  uint16_t hw[2];
+  int fixup;               /* index in the fixup table or -1 */
+  bool data;
+  bool label;              /* a label refers to this item */
+  bool deleted;
+  unsigned int new_offset;
+} pp_item_t;
+
+typedef struct {
+  instr_seq_t *seq;
+  pp_item_t *items;
+  unsigned int n;
+  unsigned int length;     /* of the original code */
+} pp_ctx_t;
+
+typedef struct {
+  const char *name;
+  unsigned int n;          /* items in the window */
+  unsigned int cycles;     /* saved when applied (estimate) */
+  bool (*apply)(pp_ctx_t *c, pp_item_t **w, unsigned int end);
+} pp_rule_t;
+
+/* ************************************************************
+   Instructions
+   ************************************************************ */
+
+static bool is16(pp_item_t *it) {
+  return it->fixup < 0 && !it->data && it->size == 1;
+}
+
+static bool is32(pp_item_t *it) {
+  return it->fixup < 0 && !it->data && it->size == 2;
+}
+
+/* Flags read and written by a 16bit instruction. Returns false for
+   instructions that leave straight line code. A call (BLX) counts as
+   writing all flags since they are not preserved across it. */
+static bool effect16(uint16_t op, unsigned int *reads, unsigned int *writes) {
+  *reads = 0;
+  *writes = 0;
+  switch (op >> 11) {
+  case 0x00: /* LSLS imm, MOVS low */
+    *writes = (op & 0x07C0) ? FLAGS_NZC : FLAGS_NZ;
+    return true;
+  case 0x01: /* LSRS imm */
+  case 0x02: /* ASRS imm */
+    *writes = FLAGS_NZC;
+    return true;
+  case 0x03: /* ADDS, SUBS reg/imm3 */
+  case 0x05: /* CMP imm8 */
+  case 0x06: /* ADDS imm8 */
+  case 0x07: /* SUBS imm8 */
+    *writes = FLAGS_ALL;
+    return true;
+  case 0x04: /* MOVS imm8 */
+    *writes = FLAGS_NZ;
+    return true;
+  case 0x08:
+    if ((op & 0xFC00) == 0x4000) {
+      switch ((op >> 6) & 0xF) {
+      case 0x5: /* ADCS */
+      case 0x6: /* SBCS */
+	*reads = FLAG_C;
+	*writes = FLAGS_ALL;
+	break;
+      case 0x9: /* RSBS */
+      case 0xA: /* CMP */
+      case 0xB: /* CMN */
+	*writes = FLAGS_ALL;
+	break;
+      default:  /* logic, shift by register (C only if nonzero), MULS */
+	*writes = FLAGS_NZ;
+	break;
+      }
+      return true;
+    }
+    if ((op & 0xFF00) == 0x4500) { /* CMP high */
+      *writes = FLAGS_ALL;
+      return true;
+    }
+    if ((op & 0xFF00) == 0x4700) { /* BX, BLX */
+      if (!(op & 0x80)) return false;
+      *writes = FLAGS_ALL;
+      return true;
+    }
+    /* ADD, MOV high, unless to PC */
+    return (op & 0x87) != 0x87;
+  case 0x16:
+  case 0x17:
+    if ((op & 0xF500) == 0xB100) return false;   /* CBZ, CBNZ */
+    if ((op & 0xFF00) == 0xBD00) return false;   /* POP {.., PC} */
+    if ((op & 0xFF00) == 0xBE00) return false;   /* BKPT */
+    if ((op & 0xFF00) == 0xBF00) return (op & 0xF) == 0; /* hints, not IT */
+    return true;
+  case 0x1A:
+  case 0x1B: /* B<c>, UDF, SVC */
+  case 0x1C: /* B */
+    return false;
+  default:   /* loads, stores, ADR, ADD SP, LDM, STM */
+    return true;
+  }
+}
+
+/* Are flags written before they are read, from item i onwards */
+static bool flags_dead(pp_ctx_t *c, unsigned int i, unsigned int flags) {
+  fixup_table_t *t = c->seq->fix;
+  for (; i < c->n && flags; i ++) {
+    pp_item_t *it = &c->items[i];
+    unsigned int reads, writes;
+    if (it->deleted) continue;
+    if (it->data) return false;
+    if (it->fixup >= 0) {
+      fixup_t *f = &t->fixups[it->fixup];
+      if (f->kind == fixup_bl) return true;
+      if (f->kind == fixup_branch) return false;
+      continue;
+    }
+    if (it->size != 1 || !effect16(it->hw[0], &reads, &writes)) return false;
+    if (reads & flags) return false;
+    flags &= ~writes;
+  }
+  return flags == 0;
+}
+
+/* ************************************************************
+   Rules
+   ************************************************************ */
+
+/* MOV rd, rd and MOVS rd, rd */
+static bool rule_mov_self(pp_ctx_t *c, pp_item_t **w, unsigned int end) {
+  if (!is16(w[0])) return false;
+  uint16_t op = w[0]->hw[0];
+  if ((op & 0xFF00) == 0x4600) {
+    unsigned int rd = ((op >> 4) & 8) | (op & 7);
+    if (rd != ((op >> 3) & 0xF) || rd == PC) return false;
+  } else if ((op & 0xFFC0) == 0x0000) {
+    if ((op & 7) != ((op >> 3) & 7) || !flags_dead(c, end, FLAGS_NZ)) return false;
+  } else {
+    return false;
+  }
+  w[0]->deleted = true;
+  return true;
+}
+
+/* MOVS rd, #a; ADDS/SUBS rd, #b -> MOVS rd, #(a +/- b) */
+static bool rule_movs_addsub(pp_ctx_t *c, pp_item_t **w, unsigned int end) {
+  if (!is16(w[0]) || !is16(w[1])) return false;
+  uint16_t mov = w[0]->hw[0];
+  uint16_t op  = w[1]->hw[0];
+  if ((mov & 0xF800) != 0x2000) return false;
+  if ((op & 0xF000) != 0x3000 || (op & 0x0700) != (mov & 0x0700)) return false;
+
+  int v = (mov & 0xFF) + ((op & 0x0800) ? -(op & 0xFF) : (op & 0xFF));
+  if (v < 0 || v > 0xFF || !flags_dead(c, end, FLAGS_CV)) return false;
+  w[0]->hw[0] = (mov & 0xFF00) | v;
+  w[1]->deleted = true;
+  return true;
+}
+
+/* ADDS/SUBS rd, #a; ADDS/SUBS rd, #b -> one ADDS/SUBS */
+static bool rule_addsub_pair(pp_ctx_t *c, pp_item_t **w, unsigned int end) {
+  if (!is16(w[0]) || !is16(w[1])) return false;
+  uint16_t a = w[0]->hw[0];
+  uint16_t b = w[1]->hw[0];
+  if ((a & 0xF000) != 0x3000 || (b & 0xF000) != 0x3000) return false;
+  if ((a & 0x0700) != (b & 0x0700)) return false;
+
+  int v = ((a & 0x0800) ? -(a & 0xFF) : (a & 0xFF)) +
+          ((b & 0x0800) ? -(b & 0xFF) : (b & 0xFF));
+  if (v < -0xFF || v > 0xFF || !flags_dead(c, end, FLAGS_CV)) return false;
+  w[0]->hw[0] = (v < 0 ? 0x3800 : 0x3000) | (a & 0x0700) | (v < 0 ? -v : v);
+  w[1]->deleted = true;
+  return true;
+}
+
+/* LSLS rt, rm, #s; ADD.W/AND.W rt, rn, rt -> ADD.W/AND.W rt, rn, rm, LSL #s */
+static bool rule_lsl_fold(pp_ctx_t *c, pp_item_t **w, unsigned int end) {
+  if (!is16(w[0]) || !is32(w[1])) return false;
+  uint16_t lsl = w[0]->hw[0];
+  uint16_t hi  = w[1]->hw[0];
+  uint16_t lo  = w[1]->hw[1];
+  if ((lsl & 0xF800) != 0x0000) return false;
+  if ((hi & 0xFFE0) != 0xEB00 && (hi & 0xFFE0) != 0xEA00) return false;
+  if (lo & 0xF0F0) return false; /* already shifted */
+
+  unsigned int rt = lsl & 7;
+  unsigned int rm = (lsl >> 3) & 7;
+  unsigned int s  = (lsl >> 6) & 0x1F;
+  unsigned int rd = (lo >> 8) & 0xF;
+  unsigned int rn = hi & 0xF;
+  unsigned int rm2 = lo & 0xF;
+  if (rd != rt || rn == SP || rn == PC) return false;
+
+  unsigned int other;
+  if (rm2 == rt && rn != rt) other = rn;
+  else if (rn == rt && rm2 != rt) other = rm2;
+  else return false;
+
+  if (!(hi & 0x10) && !flags_dead(c, end, s ? FLAGS_NZC : FLAGS_NZ)) return false;
+  w[1]->hw[0] = (hi & 0xFFF0) | other;
+  w[1]->hw[1] = (rd << 8) | rm | ((s & 3) << 6) | ((s >> 2) << 12);
+  w[0]->deleted = true;
+  return true;
+}
+
+/* B or B<c> to the instruction that follows it */
+static bool rule_branch_next(pp_ctx_t *c, pp_item_t **w, unsigned int end) {
+  fixup_table_t *t = c->seq->fix;
+  if (w[0]->fixup < 0) return false;
+  fixup_t *f = &t->fixups[w[0]->fixup];
+  if (f->kind != fixup_branch) return false;
+
+  unsigned int target = t->labels[f->label].offset;
+  while (end < c->n && c->items[end].deleted) end ++;
+  unsigned int next = end < c->n ? c->items[end].offset : c->length;
+  if (target < w[0]->offset + w[0]->size || target > next) return false;
+  w[0]->deleted = true;
+  return true;
+}
+
+static const pp_rule_t rules[] = {
+  { "mov_self",      1, 1, rule_mov_self },
+  { "movs_addsub",   2, 1, rule_movs_addsub },
+  { "addsub_pair",   2, 1, rule_addsub_pair },
+  { "lsl_fold",      2, 1, rule_lsl_fold },
+  { "branch_next",   1, 2, rule_branch_next },
+  { NULL, 0, 0, NULL }
+};
+
+#define PP_MAX_WINDOW 2
+
+/* ************************************************************
+   The pass
+   ************************************************************ */
+
+/* First item at or after offset that is not a fixup emitted before
+   nfix (a label or data bound after padding refers past the padding) */
+static unsigned int find_item(pp_ctx_t *c, unsigned int offset, unsigned int nfix) {
+  unsigned int lo = 0, hi = c->n;
+  while (lo < hi) {
+    unsigned int mid = (lo + hi) / 2;
+    if (c->items[mid].offset < offset) lo = mid + 1;
+    else hi = mid;
+  }
+  while (lo < c->n && c->items[lo].offset == offset &&
+	 c->items[lo].fixup >= 0 && (unsigned int)c->items[lo].fixup < nfix) lo ++;
+  return lo;
+}
+
+/* Where offset ends up, it may point into data (a pool entry) */
+static unsigned int new_offset(pp_ctx_t *c, unsigned int offset, unsigned int nfix,
+			       unsigned int length) {
+  unsigned int k = find_item(c, offset, nfix);
+  if (k > 0) {
+    pp_item_t *d = &c->items[k - 1];
+    if (d->data && offset < d->offset + d->size)
+      return d->new_offset + offset - d->offset;
+  }
+  return k < c->n ? c->items[k].new_offset : length;
+}
+
+static bool build_items(pp_ctx_t *c, uint16_t *code) {
+  fixup_table_t *t = c->seq->fix;
+  unsigned int fi = 0, di = 0, o = 0;
+  c->n = 0;
+
+  while (o < c->length || fi < t->n_fixups) {
+    pp_item_t *it = &c->items[c->n++];
+    memset(it, 0, sizeof(pp_item_t));
+    it->offset = o;
+    it->fixup = -1;
+    if (fi < t->n_fixups && t->fixups[fi].offset == o) {
+      it->fixup = fi;
+      it->size = t->fixups[fi++].size;
+    } else if (di < t->n_data && t->data[di].offset == o) {
+      it->data = true;
+      it->size = t->data[di++].size;
+    } else {
+      it->size = (code[o] >> 11) >= 0x1D ? 2 : 1;
+    }
+    if (o + it->size > c->length) return false;
+    for (unsigned int k = 0; k < it->size && k < 2; k ++) it->hw[k] = code[o + k];
+    o += it->size;
+  }
+
+  for (unsigned int i = 0; i < t->n_labels; i ++) {
+    unsigned int k = find_item(c, t->labels[i].offset, t->labels[i].nfix);
+    if (k < c->n) c->items[k].label = true;
+  }
+  return true;
+}
+
+/* Collect the window starting at item i, returns the index after it */
+static unsigned int window(pp_ctx_t *c, unsigned int i, unsigned int n, pp_item_t **w) {
+  for (unsigned int k = 0; k < n; k ++) {
+    bool label = false;
+    while (i < c->n && c->items[i].deleted) label |= c->items[i++].label;
+    if (i >= c->n) return 0;
+    pp_item_t *it = &c->items[i++];
+    if (it->data || (k > 0 && (label || it->label))) return 0;
+    w[k] = it;
+  }
+  return i;
+}
+
+static unsigned int apply_rules(pp_ctx_t *c, peephole_stats_t *stats) {
+  unsigned int applied = 0;
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (unsigned int i = 0; i < c->n; i ++) {
+      if (c->items[i].deleted || c->items[i].data) continue;
+      for (const pp_rule_t *r = rules; r->name; r ++) {
+	pp_item_t *w[PP_MAX_WINDOW];
+	unsigned int end = window(c, i, r->n, w);
+	if (end && r->apply(c, w, end)) {
+	  stats->cycles += r->cycles;
+	  applied ++;
+	  changed = true;
+	  if (c->items[i].deleted) break;
+	}
+      }
+    }
+  }
+  return applied;
+}
+
+/* Write the remaining code and move labels, fixups and data */
+static int relocate(pp_ctx_t *c, const uint16_t *code, uint16_t *out) {
+  fixup_table_t *t = c->seq->fix;
+  unsigned int dst = 0;
+
+  for (unsigned int i = 0; i < c->n; i ++) {
+    pp_item_t *it = &c->items[i];
+    it->new_offset = dst;
+    if (it->deleted) continue;
+    if (it->fixup >= 0) {
+      fixup_t *f = &t->fixups[it->fixup];
+      if (f->kind == fixup_align) {
+	f->size = dst & 1;
+	if (f->size) out[dst++] = m0_nop().opcode.thumb16;
+	continue;
+      }
+      if (f->kind == fixup_branch) {
+	/* shortest form, seq_resolve grows it if needed */
+	f->size = 1;
+	out[dst++] = m0_nop().opcode.thumb16;
+	continue;
+      }
+    }
+    if (it->data) {
+      memcpy(out + dst, code + it->offset, it->size * sizeof(uint16_t));
+      dst += it->size;
+      continue;
+    }
+    for (unsigned int k = 0; k < it->size; k ++) out[dst++] = it->hw[k];
+  }
+
+  /* fixups kept before each old index */
+  unsigned int *kept = c->seq->alloc((t->n_fixups + 1) * sizeof(unsigned int));
+  if (!kept) return -1;
+  memset(kept, 0, (t->n_fixups + 1) * sizeof(unsigned int));
+  for (unsigned int i = 0; i < c->n; i ++) {
+    pp_item_t *it = &c->items[i];
+    if (it->fixup >= 0 && !it->deleted) kept[it->fixup + 1] = 1;
+  }
+  for (unsigned int i = 0; i < t->n_fixups; i ++) kept[i + 1] += kept[i];
+
+  for (unsigned int i = 0; i < t->n_labels; i ++) {
+    label_info_t *l = &t->labels[i];
+    if (l->offset == LABEL_UNBOUND) continue;
+    l->offset = new_offset(c, l->offset, l->nfix, dst);
+    l->nfix = kept[l->nfix];
+  }
+  for (unsigned int i = 0; i < t->n_data; i ++) {
+    data_range_t *d = &t->data[i];
+    d->offset = new_offset(c, d->offset, d->nfix, dst);
+    d->nfix = kept[d->nfix];
+  }
+
+  unsigned int nf = 0;
+  for (unsigned int i = 0; i < c->n; i ++) {
+    pp_item_t *it = &c->items[i];
+    if (it->fixup < 0 || it->deleted) continue;
+    fixup_t f = t->fixups[it->fixup];
+    f.offset = it->new_offset;
+    f.next = -1;
+    t->fixups[nf++] = f;
+  }
+  t->n_fixups = nf;
+
+  c->seq->free(kept);
+  return (int)dst;
+}
+
+int peephole_run(instr_seq_t *seq, peephole_stats_t *stats) {
+  peephole_stats_t dummy;
+  if (!stats) stats = &dummy;
+  memset(stats, 0, sizeof(peephole_stats_t));
+
+  fixup_table_t *t = fixups_get(seq);
+  if (!t || seq->hold || lit_pool_pending(seq)) return 0;
+  for (unsigned int i = 0; i < t->n_fixups; i ++) {
+    label_t l = t->fixups[i].label;
+    if (l != LABEL_NONE && t->labels[l].offset == LABEL_UNBOUND) return 0;
+  }
+
+  pp_ctx_t c;
+  c.seq = seq;
+  c.length = seq_length(seq);
+  unsigned int cap = c.length + t->n_fixups + 1;
+  c.items = seq->alloc(cap * sizeof(pp_item_t));
+  uint16_t *code = seq->alloc(c.length * sizeof(uint16_t) + 1);
+  uint16_t *out = seq->alloc(c.length * sizeof(uint16_t) + 1);
+  int r = 0;
+  if (!c.items || !code || !out) goto done;
+
+  seq_flatten(seq, code, c.length);
+  if (!build_items(&c, code)) goto done;
+
+  stats->rewrites = apply_rules(&c, stats);
+  if (stats->rewrites == 0) {
+    r = 1;
+    goto done;
+  }
+
+  int n = relocate(&c, code, out);
+  if (n < 0 || !seq_rewrite(seq, out, n)) goto done;
+  t->relax = 1;
+  if (!seq_resolve(seq)) goto done;
+
+  stats->bytes = (c.length - seq_length(seq)) * 2;
+  r = 1;
+
+ done:
+  if (c.items) seq->free(c.items);
+  if (code) seq->free(code);
+  if (out) seq->free(out);
+  return r;
+}
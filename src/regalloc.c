@@ -0,0 +1,271 @@
+/**********************************************************************************/
+/* MIT License									  */
+/* 										  */
+/* Copyright (c) 2020 Joel Svensson             				  */
+/* 										  */
+/* Permission is hereby granted, free of charge, to any person obtaining a copy	  */
+/* of this software and associated documentation files (the "Software"), to deal  */
+/* in the Software without restriction, including without limitation the rights	  */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell	  */
+/* copies of the Software, and to permit persons to whom the Software is	  */
+/* furnished to do so, subject to the following conditions:			  */
+/* 										  */
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software.				  */
+/* 										  */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR	  */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,	  */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE	  */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER	  */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,  */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE  */
+/* SOFTWARE.									  */
+/**********************************************************************************/
+
+#include <regalloc.h>
+
+#include <string.h>
+
+#define LOW_REGS 0x00FF
+
+void ra_init(regalloc_t *ra, instr_seq_t *seq, uint16_t regs) {
+  memset(ra, 0, sizeof(regalloc_t));
+  /* SP and PC are never allocated */
+  ra->regs = regs & ~((1 << SP) | (1 << PC));
+  ra->weight = 1;
+  ra->scratch[0] = r0;
+  ra->scratch[1] = r0;
+  ra->target = seq->target;
+  ra->alloc = seq->alloc;
+  ra->free = seq->free;
+}
+
+void ra_free(regalloc_t *ra) {
+  if (ra->vregs) ra->free(ra->vregs);
+  ra->vregs = NULL;
+  ra->n = 0;
+  ra->size = 0;
+}
+
+vreg_t ra_new(regalloc_t *ra) {
+  if (ra->n == ra->size) {
+    unsigned int size = ra->size ? ra->size * 2 : 16;
+    vreg_info_t *arr = ra->alloc(size * sizeof(vreg_info_t));
+    if (!arr) return VREG_NONE;
+    if (ra->vregs) {
+      memcpy(arr, ra->vregs, ra->n * sizeof(vreg_info_t));
+      ra->free(ra->vregs);
+    }
+    ra->vregs = arr;
+    ra->size = size;
+  }
+  vreg_info_t *v = &ra->vregs[ra->n];
+  v->start = ra->pos;
+  v->end = ra->pos;
+  v->weight = 0;
+  v->low = false;
+  v->reg = RA_SPILLED;
+  v->slot = -1;
+  return (vreg_t)ra->n++;
+}
+
+int ra_use(regalloc_t *ra, vreg_t v, unsigned int flags) {
+  if (v < 0 || (unsigned int)v >= ra->n) return 0;
+  vreg_info_t *vi = &ra->vregs[v];
+  if (vi->weight == 0) vi->start = ra->pos;
+  vi->end = ra->pos;
+  vi->weight += ra->weight;
+  if (flags & RA_LOW) vi->low = true;
+  return 1;
+}
+
+void ra_next(regalloc_t *ra) {
+  ra->pos++;
+}
+
+/* Uses are counted this many times, e.g. 10 per loop nesting level */
+void ra_set_weight(regalloc_t *ra, unsigned int weight) {
+  ra->weight = weight ? weight : 1;
+}
+
+/* ************************************************************
+   Linear scan
+   ************************************************************ */
+
+/* A high register costs a 32bit instruction where a low register
+   would do with 16 bits, so ranges that want low registers count double */
+static unsigned int priority(vreg_info_t *v) {
+  return v->low ? v->weight * 2 : v->weight;
+}
+
+/* Scan the ranges in order (sorted by start) over the registers in
+   pool. Ranges that get no register are left RA_SPILLED. */
+static void scan(regalloc_t *ra, vreg_t *order, unsigned int n, uint16_t pool,
+		 vreg_t *active) {
+  unsigned int n_active = 0;
+
+  for (unsigned int i = 0; i < n; i ++) {
+    vreg_info_t *v = &ra->vregs[order[i]];
+    if (v->reg != RA_SPILLED) continue;
+
+    /* expire */
+    unsigned int k = 0;
+    for (unsigned int j = 0; j < n_active; j ++) {
+      vreg_info_t *a = &ra->vregs[active[j]];
+      if (a->reg == RA_SPILLED) continue;
+      if (a->end < v->start) pool |= 1 << a->reg;
+      else active[k++] = active[j];
+    }
+    n_active = k;
+
+    if (pool) {
+      v->reg = __builtin_ctz(pool);
+      pool &= ~(1 << v->reg);
+      active[n_active++] = order[i];
+      continue;
+    }
+
+    /* take the register of the coldest active range if this one is hotter */
+    int victim = -1;
+    for (unsigned int j = 0; j < n_active; j ++) {
+      vreg_info_t *a = &ra->vregs[active[j]];
+      if (victim < 0 || priority(a) < priority(&ra->vregs[active[victim]]) ||
+	  (priority(a) == priority(&ra->vregs[active[victim]]) &&
+	   a->end > ra->vregs[active[victim]].end))
+	victim = j;
+    }
+    if (victim >= 0) {
+      vreg_info_t *a = &ra->vregs[active[victim]];
+      if (priority(a) < priority(v) ||
+	  (priority(a) == priority(v) && a->end > v->end)) {
+	v->reg = a->reg;
+	a->reg = RA_SPILLED;
+	active[victim] = order[i];
+      }
+    }
+  }
+}
+
+/* order holds the n used ranges sorted by start, active has room for
+   2 * ra->n entries */
+static int allocate(regalloc_t *ra, uint16_t regs, vreg_t *order, unsigned int n,
+		    vreg_t *active) {
+  for (unsigned int i = 0; i < ra->n; i ++) {
+    ra->vregs[i].reg = RA_SPILLED;
+    ra->vregs[i].slot = -1;
+  }
+
+  scan(ra, order, n, regs & LOW_REGS, active);
+
+  /* high registers for what did not get a low one */
+  unsigned int m = 0;
+  vreg_t *rest = active + ra->n;
+  for (unsigned int i = 0; i < n; i ++) {
+    vreg_info_t *v = &ra->vregs[order[i]];
+    if (v->reg != RA_SPILLED) continue;
+    if (v->low && !TARGET_HAS_THUMB2(ra->target)) continue;
+    rest[m++] = order[i];
+  }
+  scan(ra, rest, m, regs & ~LOW_REGS, active);
+
+  unsigned int spilled = 0;
+  for (unsigned int i = 0; i < n; i ++) {
+    if (ra->vregs[order[i]].reg == RA_SPILLED) spilled++;
+  }
+  return spilled;
+}
+
+int ra_allocate(regalloc_t *ra) {
+  unsigned int n = ra->n;
+  ra->used = 0;
+  ra->n_slots = 0;
+  if (n == 0) return 1;
+
+  vreg_t *order = ra->alloc(n * 3 * sizeof(vreg_t));
+  if (!order) return 0;
+  vreg_t *active = order + n;
+
+  /* by start, insertion sort keeps equal starts in creation order */
+  unsigned int m = 0;
+  for (unsigned int i = 0; i < n; i ++) {
+    if (ra->vregs[i].weight == 0) continue;
+    unsigned int j = m++;
+    while (j > 0 && ra->vregs[order[j - 1]].start > ra->vregs[i].start) {
+      order[j] = order[j - 1];
+      j--;
+    }
+    order[j] = i;
+  }
+
+  int r = 1;
+  uint16_t regs = ra->regs;
+  if (allocate(ra, regs, order, m, active) > 0) {
+    /* spilling, keep the two highest low registers as scratch */
+    for (int k = 0; k < 2; k ++) {
+      uint16_t low = regs & LOW_REGS;
+      if (__builtin_popcount(low) < 3) {
+	r = 0;
+	goto done;
+      }
+      ra->scratch[k] = 31 - __builtin_clz(low);
+      regs &= ~(1 << ra->scratch[k]);
+    }
+    allocate(ra, regs, order, m, active);
+    ra->used |= (1 << ra->scratch[0]) | (1 << ra->scratch[1]);
+  }
+
+  for (unsigned int i = 0; i < n; i ++) {
+    vreg_info_t *v = &ra->vregs[i];
+    if (v->reg != RA_SPILLED) ra->used |= 1 << v->reg;
+    else if (v->weight) v->slot = ra->n_slots++;
+  }
+  if (ra->n_slots > 256) r = 0;
+
+ done:
+  ra->free(order);
+  return r;
+}
+
+/* ************************************************************
+   Using the allocation
+   ************************************************************ */
+
+int ra_reg(regalloc_t *ra, vreg_t v) {
+  if (v < 0 || (unsigned int)v >= ra->n) return RA_SPILLED;
+  return ra->vregs[v].reg;
+}
+
+unsigned int ra_frame_size(regalloc_t *ra) {
+  return ra->n_slots * 4;
+}
+
+uint16_t ra_used(regalloc_t *ra) {
+  return ra->used;
+}
+
+/* Register holding v for reading, loading it into a scratch register
+   if it is spilled. Returns -1 on failure. */
+int ra_fetch(regalloc_t *ra, instr_seq_t *seq, vreg_t v, unsigned int scratch) {
+  if (v < 0 || (unsigned int)v >= ra->n || scratch > 1) return -1;
+  vreg_info_t *vi = &ra->vregs[v];
+  if (vi->reg != RA_SPILLED) return vi->reg;
+  if (vi->slot < 0) return -1;
+  reg_t r = ra->scratch[scratch];
+  if (!emit_opcode(seq, m0_ldr_imm8(r, vi->slot))) return -1;
+  return r;
+}
+
+/* Register to compute a new value of v into */
+reg_t ra_dest(regalloc_t *ra, vreg_t v, unsigned int scratch) {
+  int r = ra_reg(ra, v);
+  return r != RA_SPILLED ? (reg_t)r : ra->scratch[scratch & 1];
+}
+
+/* Store the new value of v (computed into r) if v is spilled */
+int ra_writeback(regalloc_t *ra, instr_seq_t *seq, vreg_t v, reg_t r) {
+  if (v < 0 || (unsigned int)v >= ra->n) return 0;
+  vreg_info_t *vi = &ra->vregs[v];
+  if (vi->reg != RA_SPILLED) return 1;
+  if (vi->slot < 0) return 0;
+  return emit_opcode(seq, m0_str_imm8(r, vi->slot));
+}
@@ -0,0 +1,238 @@
+/**********************************************************************************/
+/* MIT License									  */
+/* 										  */
+/* Copyright (c) 2020 Joel Svensson             				  */
+/* 										  */
+/* Permission is hereby granted, free of charge, to any person obtaining a copy	  */
+/* of this software and associated documentation files (the "Software"), to deal  */
+/* in the Software without restriction, including without limitation the rights	  */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell	  */
+/* copies of the Software, and to permit persons to whom the Software is	  */
+/* furnished to do so, subject to the following conditions:			  */
+/* 										  */
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software.				  */
+/* 										  */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR	  */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,	  */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE	  */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER	  */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,  */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE  */
+/* SOFTWARE.									  */
+/**********************************************************************************/
+
+#include <seq.h>
+#include <labels.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+void seq_init(instr_seq_t *seq, uint16_t *mc, unsigned int size) {
+  seq->mc   = mc;
+  seq->size = mc ? size : 0;
+  seq->pos  = 0;
+
+  seq->head.next  = NULL;
+  seq->head.mc    = seq->mc;
+  seq->head.size  = seq->size;
+  seq->head.used  = 0;
+  seq->head.start = 0;
+  seq->head.owned = false;
+  seq->cur = &seq->head;
+
+  seq->chunk_size = 0;
+  seq->alloc = malloc;
+  seq->free  = free;
+
+  seq->mark = SEQ_NO_MARK;
+  seq->mark_fn = NULL;
+  seq->hold = 0;
+
+  seq->target = target_m0;
+  seq->fix = NULL;
+}
+
+/* mc/size is an optional first chunk (typically on the stack),
+   further chunks of chunk_size halfwords are taken from the heap. */
+void seq_init_chunked(instr_seq_t *seq, uint16_t *mc, unsigned int size,
+		      unsigned int chunk_size) {
+  seq_init(seq, mc, size);
+  seq->chunk_size = chunk_size < 2 ? 2 : chunk_size;
+}
+
+/* Limit size to the mark if it falls inside the current chunk */
+static void apply_mark(instr_seq_t *seq) {
+  instr_chunk_t *c = seq->cur;
+  seq->size = c->size;
+  if (seq->mark == SEQ_NO_MARK || seq->hold) return;
+  if (seq->mark < c->start + c->size) {
+    unsigned int limit = seq->mark > c->start ? seq->mark - c->start : 0;
+    seq->size = limit > seq->pos ? limit : seq->pos;
+  }
+}
+
+static void fire_mark(instr_seq_t *seq) {
+  seq_mark_fn fn = seq->mark_fn;
+  seq_clear_mark(seq);
+  if (fn) fn(seq);
+}
+
+void seq_set_mark(instr_seq_t *seq, unsigned int offset, seq_mark_fn fn) {
+  seq->mark = offset;
+  seq->mark_fn = fn;
+  apply_mark(seq);
+}
+
+void seq_clear_mark(instr_seq_t *seq) {
+  seq->mark = SEQ_NO_MARK;
+  seq->mark_fn = NULL;
+  seq->size = seq->cur->size;
+}
+
+void seq_hold(instr_seq_t *seq) {
+  seq->hold++;
+  seq->size = seq->cur->size;
+}
+
+void seq_release(instr_seq_t *seq) {
+  if (seq->hold == 0 || --seq->hold > 0) return;
+  if (seq->mark != SEQ_NO_MARK && seq_offset(seq) >= seq->mark)
+    fire_mark(seq);
+  else
+    apply_mark(seq);
+}
+
+void seq_set_allocator(instr_seq_t *seq, seq_alloc_fn alloc, seq_free_fn free) {
+  seq->alloc = alloc;
+  seq->free  = free;
+}
+
+void seq_set_target(instr_seq_t *seq, target_t target) {
+  seq->target = target;
+}
+
+static void free_chunks(instr_seq_t *seq) {
+  instr_chunk_t *c = seq->head.next;
+  while (c) {
+    instr_chunk_t *next = c->next;
+    if (c->owned) seq->free(c);
+    c = next;
+  }
+  seq->head.next = NULL;
+}
+
+void seq_free(instr_seq_t *seq) {
+  free_chunks(seq);
+  fixups_free(seq);
+  seq->head.used = 0;
+  seq->cur  = &seq->head;
+  seq->mc   = seq->head.mc;
+  seq->pos  = 0;
+  seq->hold = 0;
+  seq_clear_mark(seq);
+}
+
+int seq_grow(instr_seq_t *seq, unsigned int n) {
+  if (seq->size < seq->cur->size) {
+    fire_mark(seq);
+    if (seq->pos + n <= seq->size) return 1;
+  }
+  if (seq->chunk_size == 0) return 0;
+
+  unsigned int size = seq->chunk_size > n ? seq->chunk_size : n;
+  instr_chunk_t *c = seq->alloc(sizeof(instr_chunk_t) + size * sizeof(uint16_t));
+  if (!c) return 0;
+
+  instr_chunk_t *cur = seq->cur;
+  cur->used = seq->pos;
+
+  c->next  = NULL;
+  c->mc    = (uint16_t*)(c + 1);
+  c->size  = size;
+  c->used  = 0;
+  c->start = cur->start + cur->used;
+  c->owned = true;
+  cur->next = c;
+
+  seq->cur  = c;
+  seq->mc   = c->mc;
+  seq->pos  = 0;
+  apply_mark(seq);
+  return 1;
+}
+
+unsigned int seq_offset(instr_seq_t *seq) {
+  return seq->cur->start + seq->pos;
+}
+
+unsigned int seq_length(instr_seq_t *seq) {
+  return seq_offset(seq);
+}
+
+/* Make the used counts valid and return the first chunk.
+   Chunks are iterated in place through next. */
+instr_chunk_t *seq_chunks(instr_seq_t *seq) {
+  seq->cur->used = seq->pos;
+  return &seq->head;
+}
+
+uint16_t *seq_at(instr_seq_t *seq, unsigned int offset) {
+  instr_chunk_t *c = seq_chunks(seq);
+  for (; c; c = c->next) {
+    if (offset < c->start + c->used)
+      return &c->mc[offset - c->start];
+  }
+  return NULL;
+}
+
+/* Copy the sequence into a contiguous buffer.
+   Returns the number of halfwords written or 0 if out is too small. */
+unsigned int seq_flatten(instr_seq_t *seq, uint16_t *out, unsigned int size) {
+  unsigned int n = seq_length(seq);
+  if (n > size) return 0;
+
+  instr_chunk_t *c = seq_chunks(seq);
+  for (; c; c = c->next) {
+    memcpy(out + c->start, c->mc, c->used * sizeof(uint16_t));
+  }
+  return n;
+}
+
+/* Replace the contents of the sequence with n halfwords from mc.
+   Used by passes that move code (branch relaxation, peephole).
+   A chunked sequence keeps its first buffer if the code fits there and
+   otherwise gets a single chunk large enough for all of it.
+   mc must not point into the sequence itself. */
+int seq_rewrite(instr_seq_t *seq, const uint16_t *mc, unsigned int n) {
+  if (n <= seq->head.size) {
+    free_chunks(seq);
+    if (n) memcpy(seq->head.mc, mc, n * sizeof(uint16_t));
+    seq->cur  = &seq->head;
+    seq->mc   = seq->head.mc;
+    seq->pos  = n;
+    apply_mark(seq);
+    return 1;
+  }
+  if (seq->chunk_size == 0) return 0;
+
+  unsigned int size = seq->chunk_size > n ? seq->chunk_size : n;
+  instr_chunk_t *c = seq->alloc(sizeof(instr_chunk_t) + size * sizeof(uint16_t));
+  if (!c) return 0;
+  c->next  = NULL;
+  c->mc    = (uint16_t*)(c + 1);
+  c->size  = size;
+  c->used  = n;
+  c->start = 0;
+  c->owned = true;
+  memcpy(c->mc, mc, n * sizeof(uint16_t));
+
+  free_chunks(seq);
+  seq->head.used = 0;
+  seq->head.next = c;
+  seq->cur  = c;
+  seq->mc   = c->mc;
+  seq->pos  = n;
+  apply_mark(seq);
+  return 1;
+}
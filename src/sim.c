@@ -0,0 +1,695 @@
+/**********************************************************************************/
+/* MIT License									  */
+/* 										  */
+/* Copyright (c) 2020 Joel Svensson             				  */
+/* 										  */
+/* Permission is hereby granted, free of charge, to any person obtaining a copy	  */
+/* of this software and associated documentation files (the "Software"), to deal  */
+/* in the Software without restriction, including without limitation the rights	  */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell	  */
+/* copies of the Software, and to permit persons to whom the Software is	  */
+/* furnished to do so, subject to the following conditions:			  */
+/* 										  */
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software.				  */
+/* 										  */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR	  */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,	  */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE	  */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER	  */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,  */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE  */
+/* SOFTWARE.									  */
+/**********************************************************************************/
+
+
+#include <sim.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_BLOCK 64  /* instructions */
+
+int sim_init(sim_t *sim, target_t target, uint32_t size) {
+  memset(sim, 0, sizeof(sim_t));
+  size = (size + 7) & ~7u;
+  sim->mem = calloc(size, 1);
+  sim->block_at = malloc((size / 2) * sizeof(int32_t));
+  if (!sim->mem || !sim->block_at) {
+    sim_free(sim);
+    return 0;
+  }
+  sim->base = SIM_BASE;
+  sim->size = size;
+  sim->target = target;
+  cost_model_init(&sim->cost, target);
+  for (unsigned int i = 0; i < size / 2; i ++) sim->block_at[i] = -1;
+  sim_flush(sim);
+  sim_reset(sim);
+  return 1;
+}
+
+void sim_free(sim_t *sim) {
+  free(sim->mem);
+  free(sim->block_at);
+  free(sim->blocks);
+  free(sim->insns);
+  memset(sim, 0, sizeof(sim_t));
+}
+
+void sim_reset(sim_t *sim) {
+  memset(sim->r, 0, sizeof(sim->r));
+  sim->r[SP] = sim->base + sim->size;
+  sim->n = sim->z = sim->c = sim->v = false;
+  sim->steps = 0;
+  sim->cycles = 0;
+  sim->status = sim_done;
+  sim->fault_addr = 0;
+}
+
+void sim_flush(sim_t *sim) {
+  for (unsigned int i = 0; i < sim->n_blocks; i ++)
+    sim->block_at[(sim->blocks[i].addr - sim->base) / 2] = -1;
+  sim->n_blocks = 0;
+  sim->n_insns = 0;
+  sim->code_lo = 0xFFFFFFFF;
+  sim->code_hi = 0;
+  sim->flushes ++;
+}
+
+/* Memory */
+
+static inline bool in_mem(sim_t *sim, uint32_t addr, uint32_t n) {
+  uint32_t off = addr - sim->base;
+  return off < sim->size && n <= sim->size - off;
+}
+
+static inline bool mem_check(sim_t *sim, uint32_t addr, uint32_t n, bool strict) {
+  if (!in_mem(sim, addr, n) ||
+      ((addr & (n - 1)) && (strict || !TARGET_HAS_THUMB2(sim->target)))) {
+    sim->status = sim_fault;
+    sim->fault_addr = addr;
+    return false;
+  }
+  return true;
+}
+
+static inline uint32_t load(sim_t *sim, uint32_t addr, uint32_t n) {
+  uint8_t *p = sim->mem + (addr - sim->base);
+  switch (n) {
+  case 1: return p[0];
+  case 2: return p[0] | (p[1] << 8);
+  default: return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+  }
+}
+
+static inline void store(sim_t *sim, uint32_t addr, uint32_t n, uint32_t value) {
+  uint8_t *p = sim->mem + (addr - sim->base);
+  for (uint32_t i = 0; i < n; i ++) {
+    p[i] = (uint8_t)value;
+    value >>= 8;
+  }
+  if (addr < sim->code_hi && addr + n > sim->code_lo) sim_flush(sim);
+}
+
+int sim_write(sim_t *sim, uint32_t addr, const void *data, uint32_t n) {
+  if (!in_mem(sim, addr, n)) return 0;
+  memcpy(sim->mem + (addr - sim->base), data, n);
+  if (addr < sim->code_hi && addr + n > sim->code_lo) sim_flush(sim);
+  return 1;
+}
+
+int sim_read(sim_t *sim, uint32_t addr, void *data, uint32_t n) {
+  if (!in_mem(sim, addr, n)) return 0;
+  memcpy(data, sim->mem + (addr - sim->base), n);
+  return 1;
+}
+
+uint32_t sim_read32(sim_t *sim, uint32_t addr) {
+  if (!in_mem(sim, addr, 4)) return 0;
+  return load(sim, addr, 4);
+}
+
+int sim_write32(sim_t *sim, uint32_t addr, uint32_t value) {
+  if (!in_mem(sim, addr, 4)) return 0;
+  store(sim, addr, 4, value);
+  return 1;
+}
+
+int sim_load(sim_t *sim, uint32_t addr, instr_seq_t *seq) {
+  for (instr_chunk_t *c = seq_chunks(seq); c; c = c->next) {
+    uint32_t a = addr + c->start * 2;
+    if (!in_mem(sim, a, c->used * 2)) return 0;
+    for (unsigned int i = 0; i < c->used; i ++) {
+      sim->mem[a - sim->base + i * 2] = (uint8_t)c->mc[i];
+      sim->mem[a - sim->base + i * 2 + 1] = (uint8_t)(c->mc[i] >> 8);
+    }
+  }
+  sim_flush(sim);
+  return 1;
+}
+
+/* Decoding into blocks */
+
+static bool grow(void **arr, unsigned int *size, unsigned int need, size_t elem) {
+  if (need <= *size) return true;
+  unsigned int n = *size ? *size * 2 : 64;
+  while (n < need) n *= 2;
+  void *a = realloc(*arr, n * elem);
+  if (!a) return false;
+  *arr = a;
+  *size = n;
+  return true;
+}
+
+/* ITAdvance */
+static inline uint8_t it_advance(uint8_t it) {
+  return (it & 7) == 0 ? 0 : (it & 0xE0) | ((it << 1) & 0x1F);
+}
+
+static sim_block_t *build_block(sim_t *sim, uint32_t addr) {
+  if (!grow((void **)&sim->blocks, &sim->blocks_size, sim->n_blocks + 1, sizeof(sim_block_t)))
+    return NULL;
+
+  sim_block_t *b = &sim->blocks[sim->n_blocks];
+  b->addr = addr;
+  b->n = 0;
+  b->first = sim->n_insns;
+
+  uint32_t a = addr;
+  uint8_t it = 0;
+  for (;;) {
+    if (!grow((void **)&sim->insns, &sim->insns_size, sim->n_insns + 1, sizeof(insn_t)))
+      return NULL;
+    insn_t *in = &sim->insns[sim->n_insns];
+    uint16_t hw[2] = {0, 0};
+    unsigned int avail = 0;
+    if (in_mem(sim, a, 2)) { hw[0] = load(sim, a, 2); avail ++; }
+    if (in_mem(sim, a + 2, 2)) { hw[1] = load(sim, a + 2, 2); avail ++; }
+    if (avail == 0) break;
+    if (!decode(hw, avail, it != 0, in)) {
+      memset(in, 0, sizeof(insn_t));
+      in->op = insn_undefined;
+      in->size = 1;
+      in->cond = cond_al;
+    }
+    if ((in->flags & INSN_V7) && !TARGET_HAS_THUMB2(sim->target)) in->op = insn_undefined;
+
+    if (it) {
+      in->cond = it >> 4;
+      it = it_advance(it);
+    } else if (in->op == insn_it) {
+      it = (uint8_t)in->imm;
+    }
+    sim->n_insns ++;
+    b->n ++;
+    a += in->size * 2;
+    if (it == 0 && (insn_is_branch(in) || b->n >= MAX_BLOCK)) break;
+  }
+  if (b->n == 0) return NULL;
+
+  if (addr < sim->code_lo) sim->code_lo = addr;
+  if (a > sim->code_hi) sim->code_hi = a;
+  sim->block_at[(addr - sim->base) / 2] = (int32_t)sim->n_blocks;
+  sim->n_blocks ++;
+  return b;
+}
+
+static inline sim_block_t *block_at(sim_t *sim, uint32_t addr) {
+  if (!in_mem(sim, addr, 2)) return NULL;
+  int32_t i = sim->block_at[(addr - sim->base) / 2];
+  if (i >= 0) return &sim->blocks[i];
+  return build_block(sim, addr);
+}
+
+/* Execution */
+
+static inline bool cond_passed(sim_t *sim, unsigned int cond) {
+  bool r;
+  switch (cond >> 1) {
+  case 0: r = sim->z; break;
+  case 1: r = sim->c; break;
+  case 2: r = sim->n; break;
+  case 3: r = sim->v; break;
+  case 4: r = sim->c && !sim->z; break;
+  case 5: r = sim->n == sim->v; break;
+  case 6: r = !sim->z && sim->n == sim->v; break;
+  default: return true;
+  }
+  return (cond & 1) ? !r : r;
+}
+
+static inline uint32_t shift_c(uint32_t v, unsigned int type, unsigned int n, bool *carry) {
+  switch (type) {
+  case imm_shift_lsl:
+    if (n == 0) return v;
+    *carry = n <= 32 ? (v >> (32 - n)) & 1 : 0;
+    return n < 32 ? v << n : 0;
+  case imm_shift_lsr:
+    if (n == 0) return v;
+    *carry = n <= 32 ? (v >> (n - 1)) & 1 : 0;
+    return n < 32 ? v >> n : 0;
+  case imm_shift_asr:
+    if (n == 0) return v;
+    if (n >= 32) {
+      *carry = v >> 31;
+      return (uint32_t)((int32_t)v >> 31);
+    }
+    *carry = (v >> (n - 1)) & 1;
+    return (uint32_t)((int32_t)v >> n);
+  case imm_shift_ror:
+    if (n == 0) return v;
+    n &= 31;
+    v = n ? (v >> n) | (v << (32 - n)) : v;
+    *carry = v >> 31;
+    return v;
+  case imm_shift_rrx: {
+    uint32_t r = (v >> 1) | ((uint32_t)*carry << 31);
+    *carry = v & 1;
+    return r;
+  }
+  default:
+    return v;
+  }
+}
+
+static inline uint32_t add_with_carry(sim_t *sim, uint32_t a, uint32_t b, bool c, bool s) {
+  uint64_t u = (uint64_t)a + b + c;
+  uint32_t r = (uint32_t)u;
+  if (s) {
+    sim->n = r >> 31;
+    sim->z = r == 0;
+    sim->c = u >> 32;
+    sim->v = ((a ^ r) & (b ^ r)) >> 31;
+  }
+  return r;
+}
+
+static inline void set_nz(sim_t *sim, uint32_t r) {
+  sim->n = r >> 31;
+  sim->z = r == 0;
+}
+
+static inline uint32_t rd_reg(sim_t *sim, unsigned int r, uint32_t addr) {
+  return r == PC ? addr + 4 : sim->r[r];
+}
+
+/* BXWritePC, LoadWritePC */
+static inline void bx_write_pc(sim_t *sim, uint32_t value) {
+  if (!(value & 1)) {
+    sim->status = sim_fault;
+    sim->fault_addr = value;
+    return;
+  }
+  sim->r[PC] = value & ~1u;
+}
+
+static inline void write_result(sim_t *sim, unsigned int rd, uint32_t r) {
+  if (rd == PC) sim->r[PC] = r & ~1u;
+  else sim->r[rd] = r;
+}
+
+static void exec_mem(sim_t *sim, const insn_t *in, uint32_t addr) {
+  uint32_t base = in->rn == PC ? (addr + 4) & ~3u : sim->r[in->rn];
+  uint32_t offset;
+  if (in->flags & INSN_IMM) offset = in->imm;
+  else offset = sim->r[in->rm] << in->amount;
+  uint32_t off_addr = (in->flags & INSN_ADD) ? base + offset : base - offset;
+  uint32_t a = (in->flags & INSN_INDEX) ? off_addr : base;
+
+  uint32_t v;
+  switch (in->op) {
+  case insn_ldr:
+    if (!mem_check(sim, a, 4, false)) return;
+    v = load(sim, a, 4);
+    break;
+  case insn_ldrh:
+    if (!mem_check(sim, a, 2, false)) return;
+    v = load(sim, a, 2);
+    break;
+  case insn_ldrsh:
+    if (!mem_check(sim, a, 2, false)) return;
+    v = (uint32_t)(int16_t)load(sim, a, 2);
+    break;
+  case insn_ldrb:
+    if (!mem_check(sim, a, 1, false)) return;
+    v = load(sim, a, 1);
+    break;
+  case insn_ldrsb:
+    if (!mem_check(sim, a, 1, false)) return;
+    v = (uint32_t)(int8_t)load(sim, a, 1);
+    break;
+  case insn_str:
+    if (!mem_check(sim, a, 4, false)) return;
+    store(sim, a, 4, sim->r[in->rd]);
+    goto wback;
+  case insn_strh:
+    if (!mem_check(sim, a, 2, false)) return;
+    store(sim, a, 2, sim->r[in->rd]);
+    goto wback;
+  case insn_strb:
+    if (!mem_check(sim, a, 1, false)) return;
+    store(sim, a, 1, sim->r[in->rd]);
+    goto wback;
+  case insn_ldrd:
+    if (!mem_check(sim, a, 4, true) || !mem_check(sim, a + 4, 4, true)) return;
+    sim->r[in->rd] = load(sim, a, 4);
+    sim->r[in->ra] = load(sim, a + 4, 4);
+    goto wback;
+  case insn_strd:
+    if (!mem_check(sim, a, 4, true) || !mem_check(sim, a + 4, 4, true)) return;
+    store(sim, a, 4, sim->r[in->rd]);
+    store(sim, a + 4, 4, sim->r[in->ra]);
+    goto wback;
+  default:
+    return;
+  }
+  if (in->flags & INSN_WBACK) sim->r[in->rn] = off_addr;
+  if (in->rd == PC) bx_write_pc(sim, v);
+  else sim->r[in->rd] = v;
+  return;
+ wback:
+  if (in->flags & INSN_WBACK) sim->r[in->rn] = off_addr;
+}
+
+static void exec_multiple(sim_t *sim, const insn_t *in) {
+  uint32_t count = (uint32_t)__builtin_popcount(in->list);
+  uint32_t a = sim->r[in->rn];
+  uint32_t end = (in->flags & INSN_DB) ? a - 4 * count : a + 4 * count;
+  if (in->flags & INSN_DB) a = end;
+  if (count == 0 || !mem_check(sim, a, 4, true) || !mem_check(sim, a + 4 * (count - 1), 4, true))
+    return;
+
+  if (in->op == insn_stm) {
+    for (unsigned int r = 0; r < 16; r ++) {
+      if (!((in->list >> r) & 1)) continue;
+      store(sim, a, 4, sim->r[r]);
+      a += 4;
+    }
+    if (in->flags & INSN_WBACK) sim->r[in->rn] = end;
+    return;
+  }
+  uint32_t pc = 0;
+  for (unsigned int r = 0; r < 16; r ++) {
+    if (!((in->list >> r) & 1)) continue;
+    if (r == PC) pc = load(sim, a, 4);
+    else sim->r[r] = load(sim, a, 4);
+    a += 4;
+  }
+  if (in->flags & INSN_WBACK) sim->r[in->rn] = end;
+  if ((in->list >> PC) & 1) bx_write_pc(sim, pc);
+}
+
+static inline uint32_t bitmask(unsigned int width) {
+  return width >= 32 ? 0xFFFFFFFF : (1u << width) - 1;
+}
+
+static void exec(sim_t *sim, const insn_t *in, uint32_t addr) {
+  bool s = in->flags & INSN_S;
+  bool carry = sim->c;
+  uint32_t a, b, r;
+
+  switch (in->op) {
+  case insn_and: case insn_eor: case insn_orr: case insn_orn: case insn_bic:
+  case insn_mov: case insn_mvn: case insn_tst: case insn_teq:
+    if (in->flags & INSN_IMM) {
+      b = in->imm;
+      if (in->carry != INSN_CARRY_NONE) carry = in->carry;
+    } else {
+      b = shift_c(rd_reg(sim, in->rm, addr), in->shift, in->amount, &carry);
+    }
+    a = rd_reg(sim, in->rn, addr);
+    switch (in->op) {
+    case insn_and: case insn_tst: r = a & b; break;
+    case insn_eor: case insn_teq: r = a ^ b; break;
+    case insn_orr: r = a | b; break;
+    case insn_orn: r = a | ~b; break;
+    case insn_bic: r = a & ~b; break;
+    case insn_mov: r = b; break;
+    default: r = ~b; break;
+    }
+    if (s) {
+      set_nz(sim, r);
+      sim->c = carry;
+    }
+    if (in->op != insn_tst && in->op != insn_teq) write_result(sim, in->rd, r);
+    return;
+
+  case insn_add: case insn_adc: case insn_sub: case insn_sbc: case insn_rsb:
+  case insn_cmp: case insn_cmn:
+    if (in->flags & INSN_IMM) b = in->imm;
+    else b = shift_c(rd_reg(sim, in->rm, addr), in->shift, in->amount, &carry);
+    a = rd_reg(sim, in->rn, addr);
+    switch (in->op) {
+    case insn_add: case insn_cmn: r = add_with_carry(sim, a, b, 0, s); break;
+    case insn_adc: r = add_with_carry(sim, a, b, sim->c, s); break;
+    case insn_sub: case insn_cmp: r = add_with_carry(sim, a, ~b, 1, s); break;
+    case insn_sbc: r = add_with_carry(sim, a, ~b, sim->c, s); break;
+    default: r = add_with_carry(sim, ~a, b, 1, s); break;
+    }
+    if (in->op != insn_cmp && in->op != insn_cmn) write_result(sim, in->rd, r);
+    return;
+
+  case insn_lsl: case insn_lsr: case insn_asr: case insn_ror: {
+    static const uint8_t type[4] = {imm_shift_lsl, imm_shift_lsr, imm_shift_asr, imm_shift_ror};
+    r = shift_c(sim->r[in->rn], type[in->op - insn_lsl], sim->r[in->rm] & 0xFF, &carry);
+    if (s) {
+      set_nz(sim, r);
+      sim->c = carry;
+    }
+    sim->r[in->rd] = r;
+    return;
+  }
+
+  case insn_mul:
+    r = sim->r[in->rn] * sim->r[in->rm];
+    if (s) set_nz(sim, r);
+    sim->r[in->rd] = r;
+    return;
+  case insn_mla:
+    sim->r[in->rd] = sim->r[in->rn] * sim->r[in->rm] + sim->r[in->ra];
+    return;
+  case insn_mls:
+    sim->r[in->rd] = sim->r[in->ra] - sim->r[in->rn] * sim->r[in->rm];
+    return;
+  case insn_smull: case insn_umull: case insn_smlal: case insn_umlal: {
+    uint64_t p;
+    if (in->op == insn_smull || in->op == insn_smlal)
+      p = (uint64_t)((int64_t)(int32_t)sim->r[in->rn] * (int32_t)sim->r[in->rm]);
+    else
+      p = (uint64_t)sim->r[in->rn] * sim->r[in->rm];
+    if (in->op == insn_smlal || in->op == insn_umlal)
+      p += ((uint64_t)sim->r[in->ra] << 32) | sim->r[in->rd];
+    sim->r[in->rd] = (uint32_t)p;
+    sim->r[in->ra] = (uint32_t)(p >> 32);
+    return;
+  }
+  case insn_sdiv: {
+    int32_t n = (int32_t)sim->r[in->rn];
+    int32_t d = (int32_t)sim->r[in->rm];
+    if (d == 0) r = 0;
+    else if (d == -1) r = 0 - (uint32_t)n;
+    else r = (uint32_t)(n / d);
+    sim->r[in->rd] = r;
+    return;
+  }
+  case insn_udiv:
+    b = sim->r[in->rm];
+    sim->r[in->rd] = b ? sim->r[in->rn] / b : 0;
+    return;
+
+  case insn_clz:
+    b = sim->r[in->rm];
+    sim->r[in->rd] = b ? (uint32_t)__builtin_clz(b) : 32;
+    return;
+  case insn_rev:
+    b = sim->r[in->rm];
+    sim->r[in->rd] = (b >> 24) | ((b >> 8) & 0xFF00) | ((b << 8) & 0xFF0000) | (b << 24);
+    return;
+  case insn_rev16:
+    b = sim->r[in->rm];
+    sim->r[in->rd] = ((b >> 8) & 0x00FF00FF) | ((b << 8) & 0xFF00FF00);
+    return;
+  case insn_revsh:
+    b = sim->r[in->rm];
+    sim->r[in->rd] = (uint32_t)(int16_t)(((b >> 8) & 0xFF) | (b << 8));
+    return;
+  case insn_rbit:
+    b = sim->r[in->rm];
+    r = 0;
+    for (unsigned int i = 0; i < 32; i ++) r |= ((b >> i) & 1) << (31 - i);
+    sim->r[in->rd] = r;
+    return;
+
+  case insn_sxtb: case insn_sxth: case insn_uxtb: case insn_uxth:
+    b = sim->r[in->rm];
+    if (in->amount) b = (b >> in->amount) | (b << (32 - in->amount));
+    switch (in->op) {
+    case insn_sxtb: r = (uint32_t)(int8_t)b; break;
+    case insn_sxth: r = (uint32_t)(int16_t)b; break;
+    case insn_uxtb: r = b & 0xFF; break;
+    default: r = b & 0xFFFF; break;
+    }
+    sim->r[in->rd] = r;
+    return;
+
+  case insn_movt:
+    sim->r[in->rd] = (sim->r[in->rd] & 0xFFFF) | (in->imm << 16);
+    return;
+  case insn_bfi: case insn_bfc: {
+    uint32_t m = bitmask(in->imm - in->amount + 1) << in->amount;
+    b = in->op == insn_bfi ? sim->r[in->rn] << in->amount : 0;
+    sim->r[in->rd] = (sim->r[in->rd] & ~m) | (b & m);
+    return;
+  }
+  case insn_ubfx:
+    sim->r[in->rd] = (sim->r[in->rn] >> in->amount) & bitmask(in->imm);
+    return;
+  case insn_sbfx: {
+    unsigned int left = 32 - in->amount - in->imm;
+    sim->r[in->rd] = (uint32_t)((int32_t)(sim->r[in->rn] << left) >> (left + in->amount));
+    return;
+  }
+  case insn_adr:
+    a = (addr + 4) & ~3u;
+    sim->r[in->rd] = (in->flags & INSN_ADD) ? a + in->imm : a - in->imm;
+    return;
+
+  case insn_ldr: case insn_ldrb: case insn_ldrh: case insn_ldrsb: case insn_ldrsh:
+  case insn_str: case insn_strb: case insn_strh: case insn_ldrd: case insn_strd:
+    exec_mem(sim, in, addr);
+    return;
+  case insn_ldm: case insn_stm:
+    exec_multiple(sim, in);
+    return;
+
+  case insn_b:
+    sim->r[PC] = addr + 4 + in->imm;
+    return;
+  case insn_bl:
+    sim->r[LR] = (addr + 4) | 1;
+    sim->r[PC] = addr + 4 + in->imm;
+    return;
+  case insn_bx:
+    bx_write_pc(sim, rd_reg(sim, in->rm, addr));
+    return;
+  case insn_blx:
+    b = sim->r[in->rm];
+    sim->r[LR] = (addr + 2) | 1;
+    bx_write_pc(sim, b);
+    return;
+  case insn_cbz: case insn_cbnz:
+    if ((sim->r[in->rn] == 0) == (in->op == insn_cbz)) sim->r[PC] = addr + 4 + in->imm;
+    return;
+  case insn_tbb: case insn_tbh:
+    a = rd_reg(sim, in->rn, addr);
+    if (in->op == insn_tbb) {
+      a += sim->r[in->rm];
+      if (!mem_check(sim, a, 1, false)) return;
+      r = load(sim, a, 1);
+    } else {
+      a += sim->r[in->rm] << 1;
+      if (!mem_check(sim, a, 2, false)) return;
+      r = load(sim, a, 2);
+    }
+    sim->r[PC] = addr + 4 + 2 * r;
+    return;
+
+  case insn_svc:
+    if (!sim->svc || !sim->svc(sim, in->imm)) sim->status = sim_svc;
+    return;
+  case insn_bkpt:
+    sim->r[PC] = addr;
+    sim->status = sim_bkpt;
+    return;
+
+  case insn_mrs:
+    switch (in->imm) {
+    case 0: case 1: case 2: case 3:
+      sim->r[in->rd] = ((uint32_t)sim->n << 31) | ((uint32_t)sim->z << 30) |
+                       ((uint32_t)sim->c << 29) | ((uint32_t)sim->v << 28);
+      break;
+    case 8: case 9:
+      sim->r[in->rd] = sim->r[SP];
+      break;
+    default:
+      sim->r[in->rd] = 0;
+      break;
+    }
+    return;
+  case insn_msr:
+    b = sim->r[in->rn];
+    if (in->imm <= 3) {
+      sim->n = (b >> 31) & 1;
+      sim->z = (b >> 30) & 1;
+      sim->c = (b >> 29) & 1;
+      sim->v = (b >> 28) & 1;
+    } else if (in->imm == 8 || in->imm == 9) {
+      sim->r[SP] = b & ~3u;
+    }
+    return;
+
+  case insn_it: case insn_nop: case insn_barrier: case insn_cps:
+    return;
+
+  default:
+    sim->r[PC] = addr;
+    sim->status = sim_undefined;
+    return;
+  }
+}
+
+sim_status_t sim_run(sim_t *sim) {
+  sim->status = sim_running;
+  sim->cost.target = sim->target;
+
+  while (sim->status == sim_running) {
+    uint32_t pc = sim->r[PC];
+    if (pc == SIM_RETURN) {
+      sim->status = sim_done;
+      break;
+    }
+    sim_block_t *b = block_at(sim, pc);
+    if (!b) {
+      sim->status = sim_fault;
+      sim->fault_addr = pc;
+      break;
+    }
+
+    const insn_t *in = &sim->insns[b->first];
+    const insn_t *prev = NULL;
+    unsigned int flushes = sim->flushes;
+    uint32_t addr = b->addr;
+    for (unsigned int i = 0; i < b->n; i ++, in ++) {
+      if (sim->limit && sim->steps >= sim->limit) {
+        sim->status = sim_limit;
+        sim->r[PC] = addr;
+        break;
+      }
+      uint32_t next = addr + in->size * 2;
+      sim->r[PC] = next;
+      sim->steps ++;
+      if (in->cond == cond_al || cond_passed(sim, in->cond)) {
+        exec(sim, in, addr);
+        bool taken = (in->op != insn_cbz && in->op != insn_cbnz) || sim->r[PC] != next;
+        sim->cycles += cost_insn(&sim->cost, in, prev, taken);
+        if (sim->r[PC] != next || sim->status != sim_running || sim->flushes != flushes) break;
+      } else {
+        sim->cycles += cost_insn(&sim->cost, in, prev, false);
+      }
+      prev = in;
+      addr = next;
+    }
+  }
+  return sim->status;
+}
+
+sim_status_t sim_call(sim_t *sim, uint32_t addr, unsigned int argc, const uint32_t *args) {
+  for (unsigned int i = 0; i < 4; i ++) sim->r[i] = i < argc ? args[i] : 0;
+  sim->r[SP] = (sim->base + sim->size) & ~7u;
+  sim->r[LR] = SIM_RETURN | 1;
+  sim->r[PC] = addr & ~1u;
+  sim->steps = 0;
+  sim->cycles = 0;
+  return sim_run(sim);
+}
@@ -74,12 +74,12 @@ uint16_t byte_reverse(uint16_t in) {
 }
 
 int emit_opcode(instr_seq_t *seq, thumb_opcode_t op) {
-  if (seq->mc == NULL || seq->pos >= seq->size) return 0;
-  
-  if (op.kind == thumb32 && seq->pos <= (seq->size -2)) {
+  if (op.kind == thumb32) {
+    if (seq->pos + 2 > seq->size && !seq_grow(seq, 2)) return 0;
     seq->mc[seq->pos++] = op.opcode.thumb32.high;
     seq->mc[seq->pos++] = op.opcode.thumb32.low;
-  } else if (op.kind == thumb16 && seq->pos <= (seq->size -1)) {
+  } else if (op.kind == thumb16) {
+    if (seq->pos + 1 > seq->size && !seq_grow(seq, 1)) return 0;
     seq->mc[seq->pos++] = op.opcode.thumb16;
   } else {
     return 0;
@@ -87,6 +87,24 @@ int emit_opcode(instr_seq_t *seq, thumb_opcode_t op) {
   return 1;
 }
 
+/* Overwrite already emitted code at offset (in halfwords) */
+int emit_opcode_at(instr_seq_t *seq, unsigned int offset, thumb_opcode_t op) {
+  uint16_t *p = seq_at(seq, offset);
+  if (!p) return 0;
+
+  if (op.kind == thumb32) {
+    uint16_t *q = seq_at(seq, offset + 1);
+    if (!q) return 0;
+    *p = op.opcode.thumb32.high;
+    *q = op.opcode.thumb32.low;
+  } else if (op.kind == thumb16) {
+    *p = op.opcode.thumb16;
+  } else {
+    return 0;
+  }
+  return 1;
+}
+
 uint32_t shift_mask(imm_shift_t shift) {
   switch(shift) {
   case imm_shift_lsl:
@@ -233,6 +251,25 @@ thumb_opcode_t thumb16_opcode_two_regs_any(uint16_t opcode, reg_t r1, reg_t r2)
    Thumb 32bit encoders 
    ************************************************************ */
 
+/* Thumb-2 modified immediate, the inverse of ThumbExpandImm.
+   Returns the i:imm3:imm8 field that encodes value or -1 if there is
+   none. A rotated constant is an 8bit value with its top bit set, so
+   the rotation follows from the leading zero count. */
+int32_t thumb32_encode_mod_imm(uint32_t value) {
+  if (value <= 0xFF) return value;
+
+  uint32_t b = value & 0xFF;
+  if (value == b * 0x00010001) return 0x100 | b;
+  if (value == b * 0x01010101) return 0x300 | b;
+  b = (value >> 8) & 0xFF;
+  if (value == b * 0x01000100) return 0x200 | b;
+
+  uint32_t lz = __builtin_clz(value);
+  uint32_t shift = 24 - lz; /* moves the top set bit to bit 7 */
+  if (value & ~(0xFFu << shift)) return -1;
+  return ((8 + lz) << 7) | ((value >> shift) & 0x7F);
+}
+
 thumb_opcode_t thumb32_opcode(uint32_t opcode) {
   thumb_opcode_t op;
   op.kind = thumb32;
@@ -259,6 +296,39 @@ thumb_opcode_t thumb32_opcode_one_reg_any_imm12(uint32_t opcode,
   return op;  
 }
 
+thumb_opcode_t thumb32_opcode_one_reg_any_imm12_sf(uint32_t opcode,
+						   reg_t rd,
+						   uint16_t imm12,
+						   bool sf) {
+  thumb_opcode_t op = thumb32_opcode_one_reg_any_imm12(opcode, rd, imm12);
+  if (sf) op.opcode.thumb32.high |= (1 << 4);
+  return op;
+}
+
+/* imm16 is split as imm4:i:imm3:imm8 (MOVW, MOVT) */
+thumb_opcode_t thumb32_opcode_one_reg_any_imm16(uint32_t opcode,
+						reg_t rd,
+						uint16_t imm16) {
+  thumb_opcode_t op = thumb32_opcode_one_reg_any_imm12(opcode, rd, imm16 & IMM12_MASK);
+  op.opcode.thumb32.high |= (imm16 >> 12);
+  return op;
+}
+
+/* Modified immediate with a 32bit constant, encode_error if the
+   constant has no encoding */
+thumb_opcode_t thumb32_opcode_one_reg_any_const32_sf(uint32_t opcode,
+						     reg_t rd,
+						     uint32_t value,
+						     bool sf) {
+  thumb_opcode_t op;
+  int32_t imm12 = thumb32_encode_mod_imm(value);
+  if (imm12 < 0) {
+    op.kind = encode_error;
+    return op;
+  }
+  return thumb32_opcode_one_reg_any_imm12_sf(opcode, rd, imm12, sf);
+}
+
 thumb_opcode_t thumb32_opcode_one_reg_any_registerlist(uint32_t opcode,
 						       reg_t rn,
 						       uint16_t rl) {
@@ -314,6 +384,39 @@ thumb_opcode_t thumb32_opcode_two_regs_any_imm12_sf(uint32_t opcode,
   return op;  
 }
 
+thumb_opcode_t thumb32_opcode_two_regs_any_const32_sf(uint32_t opcode,
+						      reg_t rd,
+						      reg_t rn,
+						      uint32_t value,
+						      bool sf) {
+  thumb_opcode_t op;
+  int32_t imm12 = thumb32_encode_mod_imm(value);
+  if (imm12 < 0) {
+    op.kind = encode_error;
+    return op;
+  }
+  return thumb32_opcode_two_regs_any_imm12_sf(opcode, rd, rn, imm12, sf);
+}
+
+/* Compare and test with an immediate, Rd is 1111 in the opcode */
+thumb_opcode_t thumb32_opcode_rn_any_imm12(uint32_t opcode,
+					   reg_t rn,
+					   uint16_t imm12) {
+  return thumb32_opcode_two_regs_any_imm12(opcode, r0, rn, imm12);
+}
+
+thumb_opcode_t thumb32_opcode_rn_any_const32(uint32_t opcode,
+					     reg_t rn,
+					     uint32_t value) {
+  thumb_opcode_t op;
+  int32_t imm12 = thumb32_encode_mod_imm(value);
+  if (imm12 < 0) {
+    op.kind = encode_error;
+    return op;
+  }
+  return thumb32_opcode_two_regs_any_imm12(opcode, r0, rn, imm12);
+}
+
 thumb_opcode_t thumb32_opcode_two_regs_any_imm5_sf(uint32_t opcode,
 							 reg_t rd,
 							 reg_t rn,
@@ -336,15 +439,16 @@ thumb_opcode_t thumb32_opcode_two_regs_any_imm5_sf(uint32_t opcode,
   
 }
 
+/* Compare and test (CMP, CMN, TST, TEQ), Rd is 1111 in the opcode */
 thumb_opcode_t thumb32_opcode_two_regs_any_imm5_shift(uint32_t opcode,
-						      reg_t rd,
 						      reg_t rn,
+						      reg_t rm,
 						      uint8_t imm5,
 						      imm_shift_t shift) {
   thumb_opcode_t op;
   op.kind = thumb32;
-  opcode |= ((rd & REG_MASK) << 8);
-  opcode |= (rn & REG_MASK);
+  opcode |= ((rn & REG_MASK) << 16);
+  opcode |= (rm & REG_MASK);
   uint8_t imm2 = imm5 & 0b00000011;
   uint8_t imm3 = (imm5 >> 2) & 0b00000111;
   opcode |= ((uint32_t)imm2) << 6;
@@ -442,30 +546,34 @@ thumb_opcode_t thumb32_opcode_three_regs_any_imm5_shift_sf(uint32_t opcode,
 }
 
 
+/* imm is the byte offset from PC (instruction address + 4).
+   Conditional (T3) branches have a 21 bit offset S:J2:J1:imm6:imm11:'0' */
 thumb_opcode_t thumb32_opcode_cond_branch(uint32_t opcode,
 					  int32_t imm) {
   thumb_opcode_t op;
   op.kind = thumb32;
-  uint32_t j1 = ((1 << 24) & imm) >> 24;
-  uint32_t j2 = ((1 << 23) & imm) >> 23;
-  uint32_t s  = ((1 << 25) & imm) >> 25;
-  opcode |= (j1 | j2) | (s << 26);
+  uint32_t s  = ((1 << 20) & imm) >> 20;
+  uint32_t j2 = ((1 << 19) & imm) >> 19;
+  uint32_t j1 = ((1 << 18) & imm) >> 18;
+  opcode |= (j1 << 13) | (j2 << 11) | (s << 26);
   op.opcode.thumb32.high = (opcode >> 16);
   op.opcode.thumb32.low  = opcode;
   uint16_t imm11 = ((imm >> 1) & IMM11_MASK);
-  uint16_t imm10 = ((imm >> 12) & IMM10_MASK);
-  op.opcode.thumb32.high |= imm10;
+  uint16_t imm6  = ((imm >> 12) & IMM6_MASK);
+  op.opcode.thumb32.high |= imm6;
   op.opcode.thumb32.low |= imm11;
   return op;
 }
 
+/* Unconditional (T4) branches and BL have a 25 bit offset
+   S:I1:I2:imm10:imm11:'0' where J1 = NOT(I1 XOR S), J2 = NOT(I2 XOR S) */
 thumb_opcode_t thumb32_opcode_branch(uint32_t opcode,
 				     int32_t imm) {
   thumb_opcode_t op;
   op.kind = thumb32;
-  uint32_t i1 = ((1 << 24) & imm) >> 24;
-  uint32_t i2 = ((1 << 23) & imm) >> 23;
-  uint32_t s  = ((1 << 25) & imm) >> 25;
+  uint32_t i1 = ((1 << 23) & imm) >> 23;
+  uint32_t i2 = ((1 << 22) & imm) >> 22;
+  uint32_t s  = ((1 << 24) & imm) >> 24;
   uint32_t j1 = (s == i1) ? (1 << 13) : 0;
   uint32_t j2 = (s == i2) ? (1 << 11) : 0;
   opcode |= (j1 | j2) | (s << 26);
@@ -898,7 +1006,7 @@ thumb_opcode_t m0_isb(void) {
 }
 
 thumb_opcode_t m0_bl(int32_t offset) {
-  return thumb32_opcode_branch(4026580992, offset); 
+  return thumb32_opcode_branch(4026585088, offset); 
 }
 
 thumb_opcode_t m3_adc_imm(reg_t rd, reg_t rn, uint16_t imm12, bool sf) {
@@ -1017,8 +1125,8 @@ thumb_opcode_t m3_bic_imm(reg_t rd, reg_t rn, uint16_t imm12, bool sf) {
   return thumb32_opcode_two_regs_any_imm12_sf(4028628992, rd, rn, imm12, sf);
 }
 
-thumb_opcode_t m3_bid_any(reg_t rd, reg_t rn, reg_t rm, uint8_t imm5, imm_shift_t shift, bool sf) {
-  return thumb32_opcode_three_regs_any_imm5_shift_sf(3900702720, rd, rn, rm, imm5, shift, sf); 
+thumb_opcode_t m3_bic_any(reg_t rd, reg_t rn, reg_t rm, uint8_t imm5, imm_shift_t shift, bool sf) {
+  return thumb32_opcode_three_regs_any_imm5_shift_sf(3927965696, rd, rn, rm, imm5, shift, sf); 
 }
 
 thumb_opcode_t m3_clrex(void) {
@@ -1029,10 +1137,158 @@ thumb_opcode_t m3_clz(reg_t rd, reg_t rn, reg_t rm) {
   return thumb32_opcode_three_regs_any(4205899904, rd, rn, rm); 
 }
 
-thumb_opcode_t m3_cmn_imm(reg_t rd,uint16_t imm12) {
-  return thumb32_opcode_one_reg_any_imm12(4044361472, rd, imm12);
+thumb_opcode_t m3_cmn_imm(reg_t rn, uint16_t imm12) {
+  return thumb32_opcode_rn_any_imm12(4044361472, rn, imm12);
+}
+
+thumb_opcode_t m3_cmn_any(reg_t rn, reg_t rm, uint8_t imm5, imm_shift_t shift) {
+  return thumb32_opcode_two_regs_any_imm5_shift(3943698176, rn, rm, imm5, shift);
+}
+
+thumb_opcode_t m3_cmp_imm(reg_t rn, uint16_t imm12) {
+  return thumb32_opcode_rn_any_imm12(4054847232, rn, imm12);
+}
+
+thumb_opcode_t m3_cmp_any(reg_t rn, reg_t rm, uint8_t imm5, imm_shift_t shift) {
+  return thumb32_opcode_two_regs_any_imm5_shift(3954183936, rn, rm, imm5, shift);
+}
+
+thumb_opcode_t m3_csdb(void) {
+  return thumb32_opcode(4088365076);
+}
+
+thumb_opcode_t m3_eor_imm(reg_t rd, reg_t rn, uint16_t imm12, bool sf) {
+  return thumb32_opcode_two_regs_any_imm12_sf(4034920448, rd, rn, imm12, sf);
+}
+
+thumb_opcode_t m3_eor_any(reg_t rd, reg_t rn, reg_t rm, uint8_t imm5, imm_shift_t shift, bool sf) {
+  return thumb32_opcode_three_regs_any_imm5_shift_sf(3934257152, rd, rn, rm, imm5, shift, sf); 
+}
+
+thumb_opcode_t m3_ldm(reg_t rn, uint16_t rl) {
+  return thumb32_opcode_one_reg_any_registerlist(3901751296, rn, rl);
+}
+
+thumb_opcode_t m3_ldmw(reg_t rn, uint16_t rl) {
+  return thumb32_opcode_one_reg_any_registerlist(3903848448, rn, rl);
+}
+
+thumb_opcode_t m3_ldmdb(reg_t rn, uint16_t rl) {
+  return thumb32_opcode_one_reg_any_registerlist(3910139904, rn, rl);
+}
+
+thumb_opcode_t m3_ldmdbw(reg_t rn, uint16_t rl) {
+  return thumb32_opcode_one_reg_any_registerlist(3912237056, rn, rl);
+}
+
+thumb_opcode_t m3_ldr_imm(reg_t rd, reg_t rn, uint16_t imm12) {
+  return thumb32_opcode_two_regs_any_imm12(4174381056, rd, rn, imm12);
+}
+
+thumb_opcode_t m3_mov_imm(reg_t rd, uint16_t imm12, bool sf) {
+  return thumb32_opcode_one_reg_any_imm12_sf(4031709184, rd, imm12, sf);
+}
+
+thumb_opcode_t m3_movw(reg_t rd, uint16_t imm16) {
+  return thumb32_opcode_one_reg_any_imm16(4064280576, rd, imm16);
+}
+
+thumb_opcode_t m3_movt(reg_t rd, uint16_t imm16) {
+  return thumb32_opcode_one_reg_any_imm16(4072669184, rd, imm16);
+}
+
+thumb_opcode_t m3_mvn_imm(reg_t rd, uint16_t imm12, bool sf) {
+  return thumb32_opcode_one_reg_any_imm12_sf(4033806336, rd, imm12, sf);
+}
+
+thumb_opcode_t m3_orn_imm(reg_t rd, reg_t rn, uint16_t imm12, bool sf) {
+  return thumb32_opcode_two_regs_any_imm12_sf(4032823296, rd, rn, imm12, sf);
+}
+
+thumb_opcode_t m3_orr_imm(reg_t rd, reg_t rn, uint16_t imm12, bool sf) {
+  return thumb32_opcode_two_regs_any_imm12_sf(4030726144, rd, rn, imm12, sf);
+}
+
+thumb_opcode_t m3_rsb_imm(reg_t rd, reg_t rn, uint16_t imm12, bool sf) {
+  return thumb32_opcode_two_regs_any_imm12_sf(4055891968, rd, rn, imm12, sf);
+}
+
+thumb_opcode_t m3_sbc_imm(reg_t rd, reg_t rn, uint16_t imm12, bool sf) {
+  return thumb32_opcode_two_regs_any_imm12_sf(4049600512, rd, rn, imm12, sf);
+}
+
+thumb_opcode_t m3_sub_const(reg_t rd, reg_t rn, uint16_t imm12, bool sf) {
+  return thumb32_opcode_two_regs_any_imm12_sf(4053794816, rd, rn, imm12, sf);
+}
+
+thumb_opcode_t m3_teq_imm(reg_t rn, uint16_t imm12) {
+  return thumb32_opcode_rn_any_imm12(4035972864, rn, imm12);
+}
+
+thumb_opcode_t m3_tst_imm(reg_t rn, uint16_t imm12) {
+  return thumb32_opcode_rn_any_imm12(4027584256, rn, imm12);
+}
+
+thumb_opcode_t m3_adc_const32(reg_t rd, reg_t rn, uint32_t value, bool sf) {
+  return thumb32_opcode_two_regs_any_const32_sf(4047503360, rd, rn, value, sf);
+}
+
+thumb_opcode_t m3_add_const32(reg_t rd, reg_t rn, uint32_t value, bool sf) {
+  return thumb32_opcode_two_regs_any_const32_sf(4043309056, rd, rn, value, sf);
+}
+
+thumb_opcode_t m3_and_const32(reg_t rd, reg_t rn, uint32_t value, bool sf) {
+  return thumb32_opcode_two_regs_any_const32_sf(4026531840, rd, rn, value, sf);
+}
+
+thumb_opcode_t m3_bic_const32(reg_t rd, reg_t rn, uint32_t value, bool sf) {
+  return thumb32_opcode_two_regs_any_const32_sf(4028628992, rd, rn, value, sf);
+}
+
+thumb_opcode_t m3_cmn_const32(reg_t rn, uint32_t value) {
+  return thumb32_opcode_rn_any_const32(4044361472, rn, value);
+}
+
+thumb_opcode_t m3_cmp_const32(reg_t rn, uint32_t value) {
+  return thumb32_opcode_rn_any_const32(4054847232, rn, value);
+}
+
+thumb_opcode_t m3_eor_const32(reg_t rd, reg_t rn, uint32_t value, bool sf) {
+  return thumb32_opcode_two_regs_any_const32_sf(4034920448, rd, rn, value, sf);
+}
+
+thumb_opcode_t m3_mov_const32(reg_t rd, uint32_t value, bool sf) {
+  return thumb32_opcode_one_reg_any_const32_sf(4031709184, rd, value, sf);
+}
+
+thumb_opcode_t m3_mvn_const32(reg_t rd, uint32_t value, bool sf) {
+  return thumb32_opcode_one_reg_any_const32_sf(4033806336, rd, value, sf);
+}
+
+thumb_opcode_t m3_orn_const32(reg_t rd, reg_t rn, uint32_t value, bool sf) {
+  return thumb32_opcode_two_regs_any_const32_sf(4032823296, rd, rn, value, sf);
+}
+
+thumb_opcode_t m3_orr_const32(reg_t rd, reg_t rn, uint32_t value, bool sf) {
+  return thumb32_opcode_two_regs_any_const32_sf(4030726144, rd, rn, value, sf);
+}
+
+thumb_opcode_t m3_rsb_const32(reg_t rd, reg_t rn, uint32_t value, bool sf) {
+  return thumb32_opcode_two_regs_any_const32_sf(4055891968, rd, rn, value, sf);
+}
+
+thumb_opcode_t m3_sbc_const32(reg_t rd, reg_t rn, uint32_t value, bool sf) {
+  return thumb32_opcode_two_regs_any_const32_sf(4049600512, rd, rn, value, sf);
+}
+
+thumb_opcode_t m3_sub_const32(reg_t rd, reg_t rn, uint32_t value, bool sf) {
+  return thumb32_opcode_two_regs_any_const32_sf(4053794816, rd, rn, value, sf);
+}
+
+thumb_opcode_t m3_teq_const32(reg_t rn, uint32_t value) {
+  return thumb32_opcode_rn_any_const32(4035972864, rn, value);
 }
 
-thumb_opcode_t m3_cmn_any(reg_t rd, reg_t rn, uint8_t imm5, imm_shift_t shift) {
-  return thumb32_opcode_two_regs_any_imm5_shift(3943698176, rd, rn, imm5, shift);
+thumb_opcode_t m3_tst_const32(reg_t rn, uint32_t value) {
+  return thumb32_opcode_rn_any_const32(4027584256, rn, value);
 }
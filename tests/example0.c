@@ -40,9 +40,7 @@ int main(int argc, char **argv) {
  
   uint16_t instrs[4];
   instr_seq_t seq;
-  seq.size = 4;
-  seq.pos  = 0;
-  seq.mc = instrs;
+  seq_init(&seq, instrs, 4);
 
   if (!test_expect_init(testname)) {
     printf("error starting initializing test_expect\n");
@@ -0,0 +1,165 @@
+/**********************************************************************************/
+/* MIT License									  */
+/* 										  */
+/* Copyright (c) 2020 Joel Svensson             				  */
+/* 										  */
+/* Permission is hereby granted, free of charge, to any person obtaining a copy	  */
+/* of this software and associated documentation files (the "Software"), to deal  */
+/* in the Software without restriction, including without limitation the rights	  */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell	  */
+/* copies of the Software, and to permit persons to whom the Software is	  */
+/* furnished to do so, subject to the following conditions:			  */
+/* 										  */
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software.				  */
+/* 										  */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR	  */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,	  */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE	  */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER	  */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,  */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE  */
+/* SOFTWARE.									  */
+/**********************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <thumb.h>
+#include <labels.h>
+#include <literals.h>
+#include <constants.h>
+
+#include <test_host.h>
+
+const char *testname = "host_constants";
+
+static uint32_t expand_imm(uint32_t imm12) {
+  uint32_t b = imm12 & 0xFF;
+  if ((imm12 >> 10) == 0) {
+    switch ((imm12 >> 8) & 3) {
+    case 0: return b;
+    case 1: return b | (b << 16);
+    case 2: return (b << 8) | (b << 24);
+    default: return b | (b << 8) | (b << 16) | (b << 24);
+    }
+  }
+  uint32_t v = 0x80 | (imm12 & 0x7F);
+  uint32_t rot = imm12 >> 7;
+  return (v >> rot) | (v << (32 - rot));
+}
+
+/* Run the few instructions load_constant emits and return rd.
+   n is the number of halfwords of code (the pool follows). */
+static bool run(instr_seq_t *seq, unsigned int n, reg_t rd, uint32_t *out) {
+  uint32_t r[16] = {0};
+  unsigned int pc = 0;
+  while (pc < n) {
+    uint16_t op = *seq_at(seq, pc);
+    if ((op & 0xF800) == 0x2000) {         /* MOVS imm8 */
+      r[(op >> 8) & 7] = op & 0xFF;
+    } else if ((op & 0xF800) == 0x3000) {  /* ADDS imm8 */
+      r[(op >> 8) & 7] += op & 0xFF;
+    } else if ((op & 0xF800) == 0x0000) {  /* LSLS imm5 */
+      r[op & 7] = r[(op >> 3) & 7] << ((op >> 6) & 0x1F);
+    } else if ((op & 0xFFC0) == 0x43C0) {  /* MVNS */
+      r[op & 7] = ~r[(op >> 3) & 7];
+    } else if ((op & 0xF800) == 0x4800) {  /* LDR literal */
+      unsigned int addr = ((pc * 2 + 4) & ~3) + (op & 0xFF) * 4;
+      r[(op >> 8) & 7] = *seq_at(seq, addr / 2) | ((uint32_t)*seq_at(seq, addr / 2 + 1) << 16);
+    } else if ((op & 0xF800) == 0xF000 && pc + 1 < n) {
+      uint16_t lo = *seq_at(seq, pc + 1);
+      uint32_t rdx = (lo >> 8) & 0xF;
+      uint32_t i = (op >> 10) & 1;
+      uint32_t imm12 = (i << 11) | (((lo >> 12) & 7) << 8) | (lo & 0xFF);
+      uint32_t imm16 = ((op & 0xF) << 12) | imm12;
+      if ((op & 0xFBEF) == 0xF04F)      r[rdx] = expand_imm(imm12);   /* MOV.W */
+      else if ((op & 0xFBEF) == 0xF06F) r[rdx] = ~expand_imm(imm12);  /* MVN.W */
+      else if ((op & 0xFBF0) == 0xF240) r[rdx] = imm16;               /* MOVW */
+      else if ((op & 0xFBF0) == 0xF2C0) r[rdx] = (r[rdx] & 0xFFFF) | (imm16 << 16); /* MOVT */
+      else return false;
+      pc ++;
+    } else {
+      return false;
+    }
+    pc ++;
+  }
+  *out = r[rd];
+  return true;
+}
+
+static const uint32_t values[] = {
+  0, 1, 0xFF, 0x100, 0x1FE, 0x1FF, 0x3FC00, 0xFF000000, 0x80000000,
+  0xFFFFFFFF, 0xFFFFFF00, 0x00AB00AB, 0xAB00AB00, 0xABABABAB, 0x3F0,
+  0x12340056, 0xFFFF, 0x10000, 0x12345678, 0xDEADBEEF, 0xFFFFEDCB
+};
+
+static void check_all(target_t target, reg_t rd, const_policy_t policy) {
+  for (unsigned int i = 0; i < sizeof(values) / sizeof(values[0]); i ++) {
+    instr_seq_t seq;
+    const_plan_t plan;
+    uint32_t v;
+    seq_init_chunked(&seq, NULL, 0, 32);
+    seq_set_target(&seq, target);
+    test_check(const_plan(&seq, rd, values[i], target, policy, &plan));
+    test_check(load_constant(&seq, rd, values[i], target, policy));
+    unsigned int n = seq_length(&seq);
+    test_check(lit_pool_flush(&seq));
+    test_check(seq_resolve(&seq));
+    if (plan.strategy == const_literal) {
+      test_check(n == 1);
+    } else {
+      test_check(n * 2 == plan.bytes);
+    }
+    test_check(run(&seq, n, rd, &v) && v == values[i]);
+    seq_free(&seq);
+  }
+}
+
+int main(int argc, char **argv) {
+  (void) argc;
+  (void) argv;
+
+  check_all(target_m0, r0, const_min_bytes);
+  check_all(target_m0, r5, const_min_cycles);
+  check_all(target_m3, r2, const_min_bytes);
+  check_all(target_m3, r3, const_min_cycles);
+  check_all(target_m4, r9, const_min_bytes);
+  check_all(target_m4, r12, const_min_cycles);
+
+  instr_seq_t seq;
+  const_plan_t plan;
+  seq_init_chunked(&seq, NULL, 0, 32);
+
+  /* choices */
+  test_check(const_plan(&seq, r0, 42, target_m0, const_min_bytes, &plan));
+  test_check(plan.strategy == const_movs && plan.bytes == 2);
+  test_check(const_plan(&seq, r0, 0x3FC00, target_m0, const_min_bytes, &plan));
+  test_check(plan.strategy == const_movs_lsls);
+  test_check(const_plan(&seq, r0, 0x12345678, target_m0, const_min_bytes, &plan));
+  test_check(plan.strategy == const_literal && plan.bytes == 6);
+  test_check(const_plan(&seq, r0, 0x1234, target_m3, const_min_cycles, &plan));
+  test_check(plan.strategy == const_movw && plan.cycles == 1);
+  test_check(const_plan(&seq, r8, 0x12345678, target_m3, const_min_cycles, &plan));
+  test_check(plan.strategy == const_movw_movt && plan.cycles == 2);
+  test_check(const_plan(&seq, r0, 0x12345678, target_m3, const_min_bytes, &plan));
+  test_check(plan.strategy == const_literal);
+  test_check(const_plan(&seq, r0, 0xAB00AB00, target_m3, const_min_bytes, &plan));
+  test_check(plan.strategy == const_mov_w);
+  test_check(const_plan(&seq, r0, 0x12340056, target_m0, const_min_cycles, &plan));
+  test_check(plan.strategy == const_literal);
+
+  /* a value already in the pool costs only the load */
+  test_check(lit_load(&seq, r1, 0xDEADBEEF));
+  test_check(const_plan(&seq, r0, 0xDEADBEEF, target_m3, const_min_bytes, &plan));
+  test_check(plan.strategy == const_literal && plan.bytes == 2);
+
+  /* high registers need Thumb-2 */
+  test_check(!const_plan(&seq, r8, 1, target_m0, const_min_bytes, &plan));
+  test_check(!load_constant(&seq, r8, 1, target_m0, const_min_bytes));
+  test_check(const_plan(&seq, r8, 1, target_m3, const_min_bytes, &plan));
+  test_check(plan.strategy == const_mov_w);
+  seq_free(&seq);
+
+  return test_host_result(testname);
+}
@@ -0,0 +1,128 @@
+/**********************************************************************************/
+/* MIT License									  */
+/* 										  */
+/* Copyright (c) 2020 Joel Svensson             				  */
+/* 										  */
+/* Permission is hereby granted, free of charge, to any person obtaining a copy	  */
+/* of this software and associated documentation files (the "Software"), to deal  */
+/* in the Software without restriction, including without limitation the rights	  */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell	  */
+/* copies of the Software, and to permit persons to whom the Software is	  */
+/* furnished to do so, subject to the following conditions:			  */
+/* 										  */
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software.				  */
+/* 										  */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR	  */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,	  */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE	  */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER	  */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,  */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE  */
+/* SOFTWARE.									  */
+/**********************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <thumb.h>
+#include <labels.h>
+#include <literals.h>
+#include <cost.h>
+#include <sim.h>
+
+#include <test_host.h>
+
+const char *testname = "host_cost";
+
+static cost_model_t model(target_t target) {
+  cost_model_t m;
+  cost_model_init(&m, target);
+  return m;
+}
+
+int main(int argc, char **argv) {
+  (void) argc;
+  (void) argv;
+
+  instr_seq_t seq;
+  cost_model_t m0 = model(target_m0);
+  cost_model_t m0p = model(target_m0plus);
+  cost_model_t m3 = model(target_m3);
+
+  /* single encoder results */
+  test_check(cost_opcode(&m0, m0_mov_imm(r0, 1)) == 1);
+  test_check(cost_opcode(&m0, m0_ldr_imm5(r0, r1, 0)) == 2);
+  test_check(cost_opcode(&m0, m0_push_lr(0xF0)) == 1 + 5);
+  test_check(cost_opcode(&m0, m0_pop_lr(0xF0)) == 1 + 5 + 2);
+  test_check(cost_opcode(&m0p, m0_pop_lr(0xF0)) == 1 + 5 + 1);
+  test_check(cost_opcode(&m0, m0_bx_any(LR)) == 3);
+  test_check(cost_opcode(&m0p, m0_bx_any(LR)) == 2);
+  test_check(cost_opcode(&m3, m3_movw(r0, 0x1234)) == 1);
+
+  /* the multiplier */
+  test_check(cost_opcode(&m0, m0_mul_low(r0, r1)) == 1);
+  m0.slow_mul = true;
+  test_check(cost_opcode(&m0, m0_mul_low(r0, r1)) == 32);
+  m0.slow_mul = false;
+
+  /* load pipelining on M3 but not on M0, broken by a dependent address */
+  {
+    seq_init_chunked(&seq, NULL, 0, 64);
+    emit_opcode(&seq, m0_ldr_imm5(r1, r0, 0));
+    emit_opcode(&seq, m0_ldr_imm5(r2, r0, 1));
+    emit_opcode(&seq, m0_ldr_imm5(r3, r2, 0));
+    cost_t c;
+    test_check(cost_seq(&m3, &seq, &c) && c.cycles == 2 + 1 + 2);
+    test_check(cost_seq(&m0, &seq, &c) && c.cycles == 6);
+    test_check(c.bytes == 6 && c.instructions == 3);
+    seq_free(&seq);
+  }
+
+  /* literal pools add bytes only, conditional branches fall through */
+  {
+    seq_init_chunked(&seq, NULL, 0, 64);
+    label_t l = label_new(&seq);
+    lit_load(&seq, r0, 0x12345678);
+    emit_branch(&seq, cond_eq, l);
+    label_bind(&seq, l);
+    emit_opcode(&seq, m0_bx_any(LR));
+    lit_pool_flush(&seq);
+    seq_resolve(&seq);
+    cost_t c;
+    test_check(cost_seq(&m0, &seq, &c));
+    /* ldr, beq, bx and the nop aligning the pool */
+    test_check(c.cycles == 2 + 1 + 3 + 1);
+    test_check(c.instructions == 4);
+    test_check(c.bytes == seq_length(&seq) * 2);
+    seq_free(&seq);
+  }
+
+  /* the simulator counts cycles with the taken costs of branches */
+  {
+    sim_t sim;
+    uint32_t args[1] = {100};
+    test_check(sim_init(&sim, target_m0, 0x1000));
+    seq_init_chunked(&seq, NULL, 0, 64);
+    label_t loop = label_new(&seq);
+    emit_opcode(&seq, m0_mov_imm(r1, 0));
+    label_bind(&seq, loop);
+    emit_opcode(&seq, m0_add_low(r1, r1, r0));
+    emit_opcode(&seq, m0_sub_imm8(r0, 1));
+    emit_branch(&seq, cond_ne, loop);
+    emit_opcode(&seq, m0_mov_low(r0, r1));
+    emit_opcode(&seq, m0_bx_any(LR));
+    test_check(seq_resolve(&seq) && sim_load(&sim, SIM_BASE, &seq));
+    test_check(sim_call(&sim, SIM_BASE, 1, args) == sim_done && sim.r[0] == 5050);
+    printf("host_cost: sum loop M0 %llu cycles\n", (unsigned long long)sim.cycles);
+    test_check(sim.cycles == 1 + 100 * 2 + 99 * 3 + 1 + 1 + 3);
+    sim.target = target_m0plus;
+    test_check(sim_call(&sim, SIM_BASE, 1, args) == sim_done);
+    test_check(sim.cycles == 1 + 100 * 2 + 99 * 2 + 1 + 1 + 2);
+    seq_free(&seq);
+    sim_free(&sim);
+  }
+
+  test_host_result(testname);
+  return 0;
+}
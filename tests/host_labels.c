@@ -0,0 +1,142 @@
+/**********************************************************************************/
+/* MIT License									  */
+/* 										  */
+/* Copyright (c) 2020 Joel Svensson             				  */
+/* 										  */
+/* Permission is hereby granted, free of charge, to any person obtaining a copy	  */
+/* of this software and associated documentation files (the "Software"), to deal  */
+/* in the Software without restriction, including without limitation the rights	  */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell	  */
+/* copies of the Software, and to permit persons to whom the Software is	  */
+/* furnished to do so, subject to the following conditions:			  */
+/* 										  */
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software.				  */
+/* 										  */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR	  */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,	  */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE	  */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER	  */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,  */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE  */
+/* SOFTWARE.									  */
+/**********************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <thumb.h>
+#include <labels.h>
+
+#include <test_host.h>
+
+const char *testname = "host_labels";
+
+static void fill(instr_seq_t *seq, int n) {
+  for (int i = 0; i < n; i ++) emit_opcode(seq, m0_nop());
+}
+
+static bool op_at(instr_seq_t *seq, unsigned int offset, thumb_opcode_t op) {
+  if (op.kind == thumb16)
+    return *seq_at(seq, offset) == op.opcode.thumb16;
+  return *seq_at(seq, offset) == op.opcode.thumb32.high &&
+    *seq_at(seq, offset + 1) == op.opcode.thumb32.low;
+}
+
+int main(int argc, char **argv) {
+  (void) argc;
+  (void) argv;
+
+  instr_seq_t seq;
+
+  /* M0: short branches in both directions and BL */
+  seq_init_chunked(&seq, NULL, 0, 64);
+  label_t top = label_new(&seq);
+  label_t out = label_new(&seq);
+  label_bind(&seq, top);
+  fill(&seq, 2);
+  test_check(emit_branch(&seq, cond_eq, out));   /* at 2 */
+  test_check(emit_branch(&seq, cond_al, top));   /* at 3 */
+  test_check(emit_bl(&seq, top));                /* at 4 */
+  fill(&seq, 1);
+  test_check(label_bind(&seq, out));             /* at 7 */
+  test_check(!label_bind(&seq, out));
+  test_check(seq_resolve(&seq));
+  test_check(seq_length(&seq) == 7);
+  test_check(op_at(&seq, 2, m0_beq_imm8(3)));
+  test_check(op_at(&seq, 3, m0_b_imm11(-5 & IMM11_MASK)));
+  test_check(op_at(&seq, 4, m0_bl(-12)));
+  seq_free(&seq);
+
+  /* unbound labels are an error */
+  seq_init_chunked(&seq, NULL, 0, 64);
+  out = label_new(&seq);
+  emit_branch(&seq, cond_ne, out);
+  test_check(!seq_resolve(&seq));
+  seq_free(&seq);
+
+  /* M0: a conditional branch out of range becomes B<!c> over B */
+  seq_init_chunked(&seq, NULL, 0, 64);
+  out = label_new(&seq);
+  label_t after = label_new(&seq);
+  test_check(emit_branch(&seq, cond_eq, out));
+  test_check(emit_branch(&seq, cond_al, after));
+  fill(&seq, 200);
+  test_check(label_bind(&seq, out));             /* 202 before relaxing */
+  fill(&seq, 1);
+  test_check(label_bind(&seq, after));
+  test_check(seq_resolve(&seq));
+  test_check(seq_length(&seq) == 204);
+  test_check(label_offset(&seq, out) == 203);
+  test_check(op_at(&seq, 0, m0_bne_imm8(0)));
+  test_check(op_at(&seq, 1, m0_b_imm11(200)));
+  test_check(op_at(&seq, 2, m0_b_imm11(200)));
+  seq_free(&seq);
+
+  /* M3: a relaxed branch moves the labels and branches after it */
+  uint16_t buf[600];
+  seq_init(&seq, buf, 600);
+  seq_set_target(&seq, target_m3);
+  label_t a = label_new(&seq);
+  label_t b = label_new(&seq);
+  test_check(emit_branch(&seq, cond_ne, a));     /* 0 */
+  fill(&seq, 126);
+  test_check(emit_branch(&seq, cond_gt, b));     /* 127 */
+  fill(&seq, 1);
+  test_check(label_bind(&seq, b));               /* 129, reachable */
+  fill(&seq, 2);
+  test_check(label_bind(&seq, a));               /* 131, too far */
+  test_check(seq_resolve(&seq));
+  test_check(seq_length(&seq) == 132);
+  test_check(op_at(&seq, 0, m3_bne(260)));
+  test_check(op_at(&seq, 128, m0_bgt_imm8(0)));
+  test_check(label_offset(&seq, a) == 132);
+  test_check(label_offset(&seq, b) == 130);
+
+  /* growing one branch pushes another one out of range */
+  seq_free(&seq);
+  seq_init(&seq, buf, 600);
+  seq_set_target(&seq, target_m3);
+  a = label_new(&seq);
+  b = label_new(&seq);
+  test_check(emit_branch(&seq, cond_eq, a));     /* 0 */
+  test_check(emit_branch(&seq, cond_eq, b));     /* 1 */
+  fill(&seq, 127);
+  test_check(label_bind(&seq, a));               /* 129, just reachable */
+  fill(&seq, 100);
+  test_check(label_bind(&seq, b));
+  test_check(seq_resolve(&seq));
+  test_check(label_offset(&seq, a) == 131);
+  test_check(op_at(&seq, 0, m3_beq(258)));
+  test_check(op_at(&seq, 2, m3_beq((231 - 2) * 2 - 4)));
+
+  fill(&seq, 1);
+  label_t c = label_new(&seq);
+  emit_branch(&seq, cond_lt, c);
+  fill(&seq, 600);
+  test_check(label_bind(&seq, c));
+  test_check(!seq_resolve(&seq));                /* no room to relax */
+  seq_free(&seq);
+
+  return test_host_result(testname);
+}
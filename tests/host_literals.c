@@ -0,0 +1,136 @@
+/**********************************************************************************/
+/* MIT License									  */
+/* 										  */
+/* Copyright (c) 2020 Joel Svensson             				  */
+/* 										  */
+/* Permission is hereby granted, free of charge, to any person obtaining a copy	  */
+/* of this software and associated documentation files (the "Software"), to deal  */
+/* in the Software without restriction, including without limitation the rights	  */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell	  */
+/* copies of the Software, and to permit persons to whom the Software is	  */
+/* furnished to do so, subject to the following conditions:			  */
+/* 										  */
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software.				  */
+/* 										  */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR	  */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,	  */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE	  */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER	  */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,  */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE  */
+/* SOFTWARE.									  */
+/**********************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <thumb.h>
+#include <labels.h>
+#include <literals.h>
+
+#include <test_host.h>
+
+const char *testname = "host_literals";
+
+static void fill(instr_seq_t *seq, int n) {
+  for (int i = 0; i < n; i ++) emit_opcode(seq, m0_nop());
+}
+
+/* Follow the LDR (literal) at offset to the word it loads */
+static bool loads(instr_seq_t *seq, unsigned int offset, reg_t rd, uint32_t value) {
+  uint16_t ldr = *seq_at(seq, offset);
+  if ((ldr & 0xF800) != 0x4800 || ((ldr >> 8) & 7) != rd) return false;
+  unsigned int addr = ((offset * 2 + 4) & ~3) + (ldr & 0xFF) * 4;
+  uint16_t *lo = seq_at(seq, addr / 2);
+  uint16_t *hi = seq_at(seq, addr / 2 + 1);
+  return lo && hi && (*lo | ((uint32_t)*hi << 16)) == value;
+}
+
+int main(int argc, char **argv) {
+  (void) argc;
+  (void) argv;
+
+  instr_seq_t seq;
+
+  /* pool at the end of a function, shared entries */
+  seq_init_chunked(&seq, NULL, 0, 64);
+  test_check(lit_load(&seq, r0, 0x12345678));
+  test_check(lit_load(&seq, r1, 0xDEADBEEF));
+  test_check(lit_load(&seq, r2, 0x12345678));
+  test_check(!lit_load(&seq, r8, 0x12345678));
+  test_check(lit_pool_pending(&seq) == 2);
+  emit_opcode(&seq, m0_bx_any(LR));
+  test_check(lit_pool_flush(&seq));
+  test_check(lit_pool_pending(&seq) == 0);
+  test_check(seq_resolve(&seq));
+  test_check(seq_length(&seq) == 4 + 4);          /* 3 loads, bx, 2 words */
+  test_check(loads(&seq, 0, r0, 0x12345678));
+  test_check(loads(&seq, 1, r1, 0xDEADBEEF));
+  test_check(loads(&seq, 2, r2, 0x12345678));
+  seq_free(&seq);
+
+  /* padding before the pool */
+  seq_init_chunked(&seq, NULL, 0, 64);
+  test_check(lit_load(&seq, r7, 0xCAFEF00D));
+  test_check(lit_pool_flush(&seq));
+  test_check(seq_resolve(&seq));
+  test_check(seq_length(&seq) == 4);
+  test_check(*seq_at(&seq, 1) == m0_nop().opcode.thumb16);
+  test_check(loads(&seq, 0, r7, 0xCAFEF00D));
+  seq_free(&seq);
+
+  /* long straight line code gets an island with a branch over it */
+  seq_init_chunked(&seq, NULL, 0, 64);
+  fill(&seq, 1);
+  test_check(lit_load(&seq, r3, 0xAAAA5555));
+  fill(&seq, 1000);
+  test_check(lit_pool_pending(&seq) == 0);
+  test_check(seq_resolve(&seq));
+  test_check(loads(&seq, 1, r3, 0xAAAA5555));
+  unsigned int nops = 0, island = 0;
+  for (unsigned int i = 2; i < seq_length(&seq); i ++) {
+    if (*seq_at(&seq, i) == m0_nop().opcode.thumb16) nops++;
+    else if (!island) island = i;
+  }
+  /* B over one word, maybe a halfword of padding */
+  uint16_t b = *seq_at(&seq, island);
+  test_check((b & 0xF800) == 0xE000);
+  test_check(island < 2 + 511);
+  test_check(nops == 1000 || nops == 1001);
+  test_check((b & IMM11_MASK) == (island & 1 ? 1 : 2));
+  seq_free(&seq);
+
+  /* many constants, several islands */
+  seq_init_chunked(&seq, NULL, 0, 128);
+  for (uint32_t i = 0; i < 700; i ++) {
+    test_check(lit_load(&seq, r4, 0x10000000 + i));
+  }
+  emit_opcode(&seq, m0_bx_any(LR));
+  lit_pool_flush(&seq);
+  test_check(seq_resolve(&seq));
+  unsigned int at = 0;
+  for (uint32_t i = 0; i < 700; i ++) {
+    while ((*seq_at(&seq, at) & 0xF800) != 0x4800) at++;
+    test_check(loads(&seq, at, r4, 0x10000000 + i));
+    at++;
+  }
+  seq_free(&seq);
+
+  /* relaxed branches between a load and its pool */
+  uint16_t buf[1024];
+  seq_init(&seq, buf, 1024);
+  seq_set_target(&seq, target_m3);
+  label_t out = label_new(&seq);
+  test_check(lit_load(&seq, r0, 0x01020304));
+  for (int i = 0; i < 40; i ++) emit_branch(&seq, cond_ne, out);
+  fill(&seq, 200);
+  label_bind(&seq, out);
+  lit_pool_flush(&seq);
+  test_check(seq_resolve(&seq));
+  test_check(loads(&seq, 0, r0, 0x01020304));
+  test_check(seq_length(&seq) == 1 + 80 + 200 + 1 + 2);
+  seq_free(&seq);
+
+  return test_host_result(testname);
+}
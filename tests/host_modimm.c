@@ -0,0 +1,98 @@
+/**********************************************************************************/
+/* MIT License									  */
+/* 										  */
+/* Copyright (c) 2020 Joel Svensson             				  */
+/* 										  */
+/* Permission is hereby granted, free of charge, to any person obtaining a copy	  */
+/* of this software and associated documentation files (the "Software"), to deal  */
+/* in the Software without restriction, including without limitation the rights	  */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell	  */
+/* copies of the Software, and to permit persons to whom the Software is	  */
+/* furnished to do so, subject to the following conditions:			  */
+/* 										  */
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software.				  */
+/* 										  */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR	  */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,	  */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE	  */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER	  */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,  */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE  */
+/* SOFTWARE.									  */
+/**********************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <thumb.h>
+
+#include <test_host.h>
+
+const char *testname = "host_modimm";
+
+/* ThumbExpandImm */
+static uint32_t expand_imm(uint32_t imm12) {
+  uint32_t b = imm12 & 0xFF;
+  if ((imm12 >> 10) == 0) {
+    switch ((imm12 >> 8) & 3) {
+    case 0: return b;
+    case 1: return b | (b << 16);
+    case 2: return (b << 8) | (b << 24);
+    default: return b | (b << 8) | (b << 16) | (b << 24);
+    }
+  }
+  uint32_t v = 0x80 | (imm12 & 0x7F);
+  uint32_t rot = imm12 >> 7;
+  return (v >> rot) | (v << (32 - rot));
+}
+
+static bool is(thumb_opcode_t op, uint16_t high, uint16_t low) {
+  return op.kind == thumb32 &&
+    op.opcode.thumb32.high == high && op.opcode.thumb32.low == low;
+}
+
+int main(int argc, char **argv) {
+  (void) argc;
+  (void) argv;
+
+  /* every encodable constant round trips */
+  for (uint32_t imm12 = 0; imm12 < 4096; imm12 ++) {
+    uint32_t value = expand_imm(imm12);
+    int32_t enc = thumb32_encode_mod_imm(value);
+    test_check(enc >= 0 && expand_imm(enc) == value);
+  }
+
+  /* and nothing else is claimed to be */
+  uint32_t x = 12345;
+  for (int i = 0; i < 100000; i ++) {
+    x = x * 1103515245 + 12345;
+    uint32_t value = x >> (x & 15);
+    int32_t enc = thumb32_encode_mod_imm(value);
+    if (enc >= 0) test_check(expand_imm(enc) == value);
+  }
+  test_check(thumb32_encode_mod_imm(0x101) < 0);
+  test_check(thumb32_encode_mod_imm(0x1FF) < 0);
+  test_check(thumb32_encode_mod_imm(0x12345678) < 0);
+  test_check(thumb32_encode_mod_imm(0xFF00FF01) < 0);
+  test_check(thumb32_encode_mod_imm(0x80000001) < 0);
+
+  /* encodings, as given by an assembler */
+  test_check(is(m3_cmp_const32(r3, 0xFF00FF00), 0xF1B3, 0x2FFF));
+  test_check(is(m3_and_const32(r1, r2, 0x3FC00, true), 0xF412, 0x317F));
+  test_check(is(m3_tst_const32(r9, 0x80000000), 0xF019, 0x4F00));
+  test_check(is(m3_cmn_const32(r4, 1), 0xF114, 0x0F01));
+  test_check(is(m3_orr_const32(r5, r6, 0xABABABAB, false), 0xF046, 0x35AB));
+  test_check(is(m3_sub_const32(r8, r8, 0x1FE, false), 0xF5A8, 0x78FF));
+  test_check(is(m3_mvn_const32(r0, 0xFF, false), 0xF06F, 0x00FF));
+  test_check(is(m3_teq_const32(r0, 4), 0xF090, 0x0F04));
+  test_check(is(m3_cmn_imm(r4, 1), 0xF114, 0x0F01));
+  test_check(is(m3_cmp_any(r2, r7, 3, imm_shift_lsl), 0xEBB2, 0x0FC7));
+  test_check(is(m3_bic_any(r1, r2, r3, 0, imm_shift_lsl, false), 0xEA22, 0x0103));
+
+  test_check(m3_add_const32(r0, r1, 0x12345678, false).kind == encode_error);
+  test_check(m3_cmp_const32(r0, 0x101).kind == encode_error);
+  test_check(m3_mov_const32(r0, 0x1FF, false).kind == encode_error);
+
+  return test_host_result(testname);
+}
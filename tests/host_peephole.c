@@ -0,0 +1,195 @@
+/**********************************************************************************/
+/* MIT License									  */
+/* 										  */
+/* Copyright (c) 2020 Joel Svensson             				  */
+/* 										  */
+/* Permission is hereby granted, free of charge, to any person obtaining a copy	  */
+/* of this software and associated documentation files (the "Software"), to deal  */
+/* in the Software without restriction, including without limitation the rights	  */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell	  */
+/* copies of the Software, and to permit persons to whom the Software is	  */
+/* furnished to do so, subject to the following conditions:			  */
+/* 										  */
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software.				  */
+/* 										  */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR	  */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,	  */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE	  */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER	  */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,  */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE  */
+/* SOFTWARE.									  */
+/**********************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <thumb.h>
+#include <labels.h>
+#include <literals.h>
+#include <peephole.h>
+
+#include <test_host.h>
+
+const char *testname = "host_peephole";
+
+static uint16_t op16(thumb_opcode_t op) {
+  return op.opcode.thumb16;
+}
+
+/* Compare the sequence with the expected halfwords */
+static bool code_is(instr_seq_t *seq, const uint16_t *expect, unsigned int n) {
+  if (seq_length(seq) != n) return false;
+  for (unsigned int i = 0; i < n; i ++) {
+    if (*seq_at(seq, i) != expect[i]) return false;
+  }
+  return true;
+}
+
+static bool loads(instr_seq_t *seq, unsigned int offset, reg_t rd, uint32_t value) {
+  uint16_t ldr = *seq_at(seq, offset);
+  if ((ldr & 0xF800) != 0x4800 || ((ldr >> 8) & 7) != rd) return false;
+  unsigned int addr = ((offset * 2 + 4) & ~3) + (ldr & 0xFF) * 4;
+  uint16_t *lo = seq_at(seq, addr / 2);
+  uint16_t *hi = seq_at(seq, addr / 2 + 1);
+  return lo && hi && (*lo | ((uint32_t)*hi << 16)) == value;
+}
+
+int main(int argc, char **argv) {
+  (void) argc;
+  (void) argv;
+
+  instr_seq_t seq;
+  peephole_stats_t stats;
+
+  /* self moves, the flag setting one only when the flags are dead */
+  seq_init_chunked(&seq, NULL, 0, 16);
+  emit_opcode(&seq, m0_mov_any(r9, r9));
+  emit_opcode(&seq, m0_mov_low(r2, r2));
+  emit_opcode(&seq, m0_cmp_imm8(r0, 1));
+  emit_opcode(&seq, m0_mov_low(r3, r3));
+  emit_opcode(&seq, m0_bx_any(LR));
+  test_check(peephole_run(&seq, &stats));
+  {
+    uint16_t expect[] = { op16(m0_cmp_imm8(r0, 1)), op16(m0_mov_low(r3, r3)),
+			  op16(m0_bx_any(LR)) };
+    test_check(code_is(&seq, expect, 3));
+  }
+  test_check(stats.rewrites == 2 && stats.bytes == 4 && stats.cycles == 2);
+  seq_free(&seq);
+
+  /* constant folding, repeated */
+  seq_init_chunked(&seq, NULL, 0, 16);
+  emit_opcode(&seq, m0_mov_imm(r1, 1));
+  emit_opcode(&seq, m0_add_imm8(r1, 2));
+  emit_opcode(&seq, m0_add_imm8(r1, 3));
+  emit_opcode(&seq, m0_sub_imm8(r1, 1));
+  emit_opcode(&seq, m0_add_imm8(r2, 200));
+  emit_opcode(&seq, m0_sub_imm8(r2, 250));
+  emit_opcode(&seq, m0_mov_imm(r3, 200));
+  emit_opcode(&seq, m0_add_imm8(r3, 100));   /* does not fit */
+  emit_opcode(&seq, m0_cmp_imm8(r0, 0));
+  emit_opcode(&seq, m0_mov_imm(r4, 1));
+  emit_opcode(&seq, m0_add_imm8(r4, 1));     /* C and V are live */
+  emit_opcode(&seq, m0_bx_any(LR));
+  test_check(peephole_run(&seq, &stats));
+  {
+    uint16_t expect[] = { op16(m0_mov_imm(r1, 5)), op16(m0_sub_imm8(r2, 50)),
+			  op16(m0_mov_imm(r3, 200)), op16(m0_add_imm8(r3, 100)),
+			  op16(m0_cmp_imm8(r0, 0)), op16(m0_mov_imm(r4, 1)),
+			  op16(m0_add_imm8(r4, 1)), op16(m0_bx_any(LR)) };
+    test_check(code_is(&seq, expect, 8));
+  }
+  test_check(stats.rewrites == 4 && stats.bytes == 8);
+  seq_free(&seq);
+
+  /* shift folded into the operand */
+  seq_init_chunked(&seq, NULL, 0, 16);
+  seq_set_target(&seq, target_m3);
+  emit_opcode(&seq, m0_lsl_imm5(r2, r1, 2));
+  emit_opcode(&seq, m3_add_any(r2, r0, r2, 0, imm_shift_lsl, false));
+  emit_opcode(&seq, m0_lsl_imm5(r3, r3, 4));
+  emit_opcode(&seq, m3_and_any(r3, r3, r5, 0, imm_shift_lsl, true));
+  emit_opcode(&seq, m0_lsl_imm5(r4, r1, 3));
+  emit_opcode(&seq, m3_add_any(r5, r0, r4, 0, imm_shift_lsl, true)); /* r4 still live */
+  emit_opcode(&seq, m0_bx_any(LR));
+  test_check(peephole_run(&seq, &stats));
+  {
+    thumb_opcode_t add = m3_add_any(r2, r0, r1, 2, imm_shift_lsl, false);
+    thumb_opcode_t and = m3_and_any(r3, r5, r3, 4, imm_shift_lsl, true);
+    thumb_opcode_t add2 = m3_add_any(r5, r0, r4, 0, imm_shift_lsl, true);
+    uint16_t expect[] = { add.opcode.thumb32.high, add.opcode.thumb32.low,
+			  and.opcode.thumb32.high, and.opcode.thumb32.low,
+			  op16(m0_lsl_imm5(r4, r1, 3)),
+			  add2.opcode.thumb32.high, add2.opcode.thumb32.low,
+			  op16(m0_bx_any(LR)) };
+    test_check(code_is(&seq, expect, 8));
+  }
+  test_check(stats.rewrites == 2 && stats.bytes == 4);
+  seq_free(&seq);
+
+  /* branches to the next instruction, labels block merging */
+  seq_init_chunked(&seq, NULL, 0, 16);
+  label_t top = label_new(&seq);
+  label_t l1 = label_new(&seq);
+  label_t l2 = label_new(&seq);
+  label_t l3 = label_new(&seq);
+  label_bind(&seq, top);
+  emit_opcode(&seq, m0_mov_any(r3, r3));
+  emit_opcode(&seq, m0_sub_imm8(r0, 1));
+  emit_branch(&seq, cond_al, l1);
+  label_bind(&seq, l1);
+  emit_branch(&seq, cond_eq, l2);
+  emit_opcode(&seq, m0_mov_any(r4, r4));
+  label_bind(&seq, l2);
+  emit_opcode(&seq, m0_mov_imm(r1, 1));
+  label_bind(&seq, l3);
+  emit_opcode(&seq, m0_add_imm8(r1, 1));
+  emit_opcode(&seq, m0_cmp_imm8(r1, 9));
+  emit_branch(&seq, cond_ne, top);
+  emit_branch(&seq, cond_al, l3);
+  test_check(seq_resolve(&seq));
+  test_check(peephole_run(&seq, &stats));
+  {
+    uint16_t expect[] = { op16(m0_sub_imm8(r0, 1)),
+			  op16(m0_mov_imm(r1, 1)),
+			  op16(m0_add_imm8(r1, 1)),
+			  op16(m0_cmp_imm8(r1, 9)),
+			  op16(m0_bne_imm8((uint8_t)-6)),
+			  op16(m0_b_imm11((uint16_t)-5 & IMM11_MASK)) };
+    test_check(code_is(&seq, expect, 6));
+  }
+  test_check(label_offset(&seq, top) == 0);
+  test_check(label_offset(&seq, l1) == 1);
+  test_check(label_offset(&seq, l2) == 1);
+  test_check(label_offset(&seq, l3) == 2);
+  test_check(fixups_get(&seq)->n_fixups == 2);
+  test_check(stats.rewrites == 4 && stats.bytes == 8);
+  seq_free(&seq);
+
+  /* literal loads and their pool move with the code */
+  seq_init_chunked(&seq, NULL, 0, 16);
+  test_check(lit_load(&seq, r0, 0x12345678));
+  emit_opcode(&seq, m0_mov_any(r8, r8));
+  test_check(lit_load(&seq, r1, 0xCAFEF00D));
+  emit_opcode(&seq, m0_bx_any(LR));
+  test_check(lit_pool_flush(&seq));
+  test_check(peephole_run(&seq, &stats));
+  test_check(seq_length(&seq) == 3 + 1 + 4);     /* the pool needs padding now */
+  test_check(loads(&seq, 0, r0, 0x12345678));
+  test_check(loads(&seq, 1, r1, 0xCAFEF00D));
+  test_check(seq_is_data(&seq, 4) && seq_is_data(&seq, 7) && !seq_is_data(&seq, 2));
+  test_check(stats.rewrites == 1 && stats.bytes == 0);
+  seq_free(&seq);
+
+  /* nothing to do, and refusing code with pending work */
+  seq_init_chunked(&seq, NULL, 0, 16);
+  emit_opcode(&seq, m0_bx_any(LR));
+  test_check(peephole_run(&seq, &stats) && stats.rewrites == 0);
+  test_check(lit_load(&seq, r0, 1234567));
+  test_check(!peephole_run(&seq, &stats));
+  seq_free(&seq);
+
+  return test_host_result(testname);
+}
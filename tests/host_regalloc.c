@@ -0,0 +1,169 @@
+/**********************************************************************************/
+/* MIT License									  */
+/* 										  */
+/* Copyright (c) 2020 Joel Svensson             				  */
+/* 										  */
+/* Permission is hereby granted, free of charge, to any person obtaining a copy	  */
+/* of this software and associated documentation files (the "Software"), to deal  */
+/* in the Software without restriction, including without limitation the rights	  */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell	  */
+/* copies of the Software, and to permit persons to whom the Software is	  */
+/* furnished to do so, subject to the following conditions:			  */
+/* 										  */
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software.				  */
+/* 										  */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR	  */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,	  */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE	  */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER	  */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,  */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE  */
+/* SOFTWARE.									  */
+/**********************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <thumb.h>
+#include <regalloc.h>
+
+#include <test_host.h>
+
+const char *testname = "host_regalloc";
+
+/* Describe n ranges that all overlap, range i used weights[i] times */
+static void overlapping(regalloc_t *ra, vreg_t *v, unsigned int n,
+			const unsigned int *weights, unsigned int flags) {
+  for (unsigned int i = 0; i < n; i ++) {
+    v[i] = ra_new(ra);
+    ra_use(ra, v[i], flags);
+    ra_next(ra);
+  }
+  for (unsigned int i = 0; i < n; i ++) {
+    for (unsigned int k = 1; k < weights[i]; k ++) {
+      ra_use(ra, v[i], flags);
+      ra_next(ra);
+    }
+  }
+  for (unsigned int i = 0; i < n; i ++) ra_use(ra, v[i], 0);
+}
+
+static bool valid(regalloc_t *ra, target_t target) {
+  for (unsigned int i = 0; i < ra->n; i ++) {
+    vreg_info_t *a = &ra->vregs[i];
+    if (a->weight == 0) continue;
+    if (a->reg == RA_SPILLED) {
+      if (a->slot < 0) return false;
+      continue;
+    }
+    if (!(ra->regs & (1 << a->reg))) return false;
+    if (a->low && a->reg > r7 && !TARGET_HAS_THUMB2(target)) return false;
+    for (unsigned int j = i + 1; j < ra->n; j ++) {
+      vreg_info_t *b = &ra->vregs[j];
+      if (b->weight == 0 || b->reg != a->reg) continue;
+      if (!(a->end < b->start || b->end < a->start)) return false;
+    }
+    if (ra->n_slots && (a->reg == ra->scratch[0] || a->reg == ra->scratch[1]))
+      return false;
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  (void) argc;
+  (void) argv;
+
+  instr_seq_t seq;
+  uint16_t mc[64];
+  regalloc_t ra;
+  vreg_t v[16];
+
+  /* short ranges share registers */
+  seq_init(&seq, mc, 64);
+  ra_init(&ra, &seq, 0x1FFF);
+  for (int i = 0; i < 4; i ++) {
+    v[i] = ra_new(&ra);
+    ra_use(&ra, v[i], RA_LOW);
+    ra_next(&ra);
+    ra_use(&ra, v[i], RA_LOW);
+    ra_next(&ra);
+  }
+  test_check(ra_allocate(&ra));
+  for (int i = 0; i < 4; i ++) test_check(ra_reg(&ra, v[i]) == r0);
+  test_check(ra_frame_size(&ra) == 0 && ra_used(&ra) == 1);
+  ra_free(&ra);
+
+  /* M3, twelve live values: the eight hottest get low registers */
+  {
+    const unsigned int w[12] = { 1, 9, 2, 8, 3, 7, 4, 6, 5, 10, 11, 12 };
+    seq_set_target(&seq, target_m3);
+    ra_init(&ra, &seq, 0x1FFF);
+    overlapping(&ra, v, 12, w, 0);
+    test_check(ra_allocate(&ra));
+    test_check(valid(&ra, target_m3));
+    test_check(ra_frame_size(&ra) == 0);
+    for (int i = 0; i < 12; i ++) {
+      int r = ra_reg(&ra, v[i]);
+      test_check(r != RA_SPILLED);
+      test_check((w[i] > 4) == (r <= r7));
+    }
+    ra_free(&ra);
+  }
+
+  /* M0, ten values that need low registers: two low registers become
+     scratch, the six hottest get the rest, the others are spilled */
+  {
+    const unsigned int w[10] = { 5, 1, 6, 2, 7, 3, 8, 4, 9, 10 };
+    seq_set_target(&seq, target_m0);
+    ra_init(&ra, &seq, 0x1FFF);
+    overlapping(&ra, v, 10, w, RA_LOW);
+    vreg_t hi = ra_new(&ra);
+    ra_use(&ra, hi, 0);
+    test_check(ra_allocate(&ra));
+    test_check(valid(&ra, target_m0));
+    test_check(ra.scratch[0] == r7 && ra.scratch[1] == r6);
+    for (int i = 0; i < 10; i ++) {
+      int r = ra_reg(&ra, v[i]);
+      test_check((w[i] > 4) == (r != RA_SPILLED));
+      test_check(r == RA_SPILLED || r <= r5);
+    }
+    test_check(ra_reg(&ra, hi) >= r8);
+    test_check(ra_frame_size(&ra) == 16);
+
+    /* spill code */
+    int r = ra_fetch(&ra, &seq, v[1], 0);
+    test_check(r == r7);
+    test_check(seq_length(&seq) == 1);
+    test_check(mc[0] == m0_ldr_imm8(r7, ra.vregs[v[1]].slot).opcode.thumb16);
+    test_check(ra_dest(&ra, v[3], 1) == r6);
+    test_check(ra_writeback(&ra, &seq, v[3], r6));
+    test_check(mc[1] == m0_str_imm8(r6, ra.vregs[v[3]].slot).opcode.thumb16);
+    test_check(ra_fetch(&ra, &seq, v[9], 0) == ra_reg(&ra, v[9]));
+    test_check(ra_writeback(&ra, &seq, v[9], ra_dest(&ra, v[9], 0)));
+    test_check(seq_length(&seq) == 2);
+    ra_free(&ra);
+  }
+
+  /* random ranges */
+  uint32_t x = 1;
+  for (int round = 0; round < 200; round ++) {
+    target_t target = round & 1 ? target_m3 : target_m0;
+    seq_set_target(&seq, target);
+    ra_init(&ra, &seq, round & 2 ? 0x5FFF : 0x00FF);
+    unsigned int n = 1 + round % 40;
+    for (unsigned int i = 0; i < n; i ++) ra_new(&ra);
+    for (unsigned int pos = 0; pos < 100; pos ++) {
+      x = x * 1103515245 + 12345;
+      vreg_t a = (x >> 8) % n;
+      ra_set_weight(&ra, 1 + ((x >> 20) & 3));
+      ra_use(&ra, a, (x >> 4) & 1 ? RA_LOW : 0);
+      ra_next(&ra);
+    }
+    test_check(ra_allocate(&ra));
+    test_check(valid(&ra, target));
+    ra_free(&ra);
+  }
+
+  return test_host_result(testname);
+}
@@ -0,0 +1,94 @@
+/**********************************************************************************/
+/* MIT License									  */
+/* 										  */
+/* Copyright (c) 2020 Joel Svensson             				  */
+/* 										  */
+/* Permission is hereby granted, free of charge, to any person obtaining a copy	  */
+/* of this software and associated documentation files (the "Software"), to deal  */
+/* in the Software without restriction, including without limitation the rights	  */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell	  */
+/* copies of the Software, and to permit persons to whom the Software is	  */
+/* furnished to do so, subject to the following conditions:			  */
+/* 										  */
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software.				  */
+/* 										  */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR	  */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,	  */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE	  */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER	  */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,  */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE  */
+/* SOFTWARE.									  */
+/**********************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <thumb.h>
+
+#include <test_host.h>
+
+const char *testname = "host_seq";
+
+int main(int argc, char **argv) {
+  (void) argc;
+  (void) argv;
+
+  /* fixed buffer: emission stops when full */
+  uint16_t fixed[3];
+  instr_seq_t seq;
+  seq_init(&seq, fixed, 3);
+
+  test_check(emit_opcode(&seq, m0_mov_imm(r0, 1)));
+  test_check(emit_opcode(&seq, m0_mov_imm(r1, 2)));
+  test_check(!emit_opcode(&seq, m0_dsb()));
+  test_check(emit_opcode(&seq, m0_nop()));
+  test_check(!emit_opcode(&seq, m0_nop()));
+  test_check(seq_length(&seq) == 3);
+
+  /* chunked: small stack buffer spilling into heap chunks */
+  uint16_t small[5];
+  seq_init_chunked(&seq, small, 5, 4);
+
+  for (int i = 0; i < 20; i ++) {
+    test_check(emit_opcode(&seq, m0_mov_imm(r0, i)));
+    test_check(emit_opcode(&seq, m0_isb()));
+  }
+  test_check(seq_length(&seq) == 60);
+  test_check(seq.head.next != NULL);
+
+  /* 32bit ops are never split between chunks */
+  unsigned int n = 0;
+  for (instr_chunk_t *c = seq_chunks(&seq); c; c = c->next) {
+    test_check(c->start == n);
+    n += c->used;
+  }
+  test_check(n == 60);
+
+  uint16_t *flat = malloc(60 * sizeof(uint16_t));
+  test_check(seq_flatten(&seq, flat, 59) == 0);
+  test_check(seq_flatten(&seq, flat, 60) == 60);
+
+  thumb_opcode_t isb = m0_isb();
+  for (int i = 0; i < 20; i ++) {
+    test_check(flat[i*3] == m0_mov_imm(r0, i).opcode.thumb16);
+    test_check(flat[i*3+1] == isb.opcode.thumb32.high);
+    test_check(flat[i*3+2] == isb.opcode.thumb32.low);
+    test_check(*seq_at(&seq, i*3 + 1) == isb.opcode.thumb32.high);
+  }
+  test_check(seq_at(&seq, 60) == NULL);
+
+  free(flat);
+  seq_free(&seq);
+  test_check(seq_length(&seq) == 0);
+
+  /* chunked without an initial buffer */
+  seq_init_chunked(&seq, NULL, 0, 16);
+  test_check(emit_opcode(&seq, m0_nop()));
+  test_check(seq_length(&seq) == 1);
+  test_check(*seq_at(&seq, 0) == m0_nop().opcode.thumb16);
+  seq_free(&seq);
+
+  return test_host_result(testname);
+}
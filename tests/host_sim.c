@@ -0,0 +1,317 @@
+/**********************************************************************************/
+/* MIT License									  */
+/* 										  */
+/* Copyright (c) 2020 Joel Svensson             				  */
+/* 										  */
+/* Permission is hereby granted, free of charge, to any person obtaining a copy	  */
+/* of this software and associated documentation files (the "Software"), to deal  */
+/* in the Software without restriction, including without limitation the rights	  */
+/* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell	  */
+/* copies of the Software, and to permit persons to whom the Software is	  */
+/* furnished to do so, subject to the following conditions:			  */
+/* 										  */
+/* The above copyright notice and this permission notice shall be included in all */
+/* copies or substantial portions of the Software.				  */
+/* 										  */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR	  */
+/* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,	  */
+/* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE	  */
+/* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER	  */
+/* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,  */
+/* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE  */
+/* SOFTWARE.									  */
+/**********************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <thumb.h>
+#include <labels.h>
+#include <literals.h>
+#include <constants.h>
+#include <sim.h>
+
+#include <test_host.h>
+
+const char *testname = "host_sim";
+
+static sim_t sim;
+
+static uint32_t rnd_state = 0x12345678;
+
+static uint32_t rnd(void) {
+  rnd_state ^= rnd_state << 13;
+  rnd_state ^= rnd_state >> 17;
+  rnd_state ^= rnd_state << 5;
+  return rnd_state;
+}
+
+static void start(instr_seq_t *seq, target_t target) {
+  seq_init_chunked(seq, NULL, 0, 64);
+  seq_set_target(seq, target);
+  sim.target = target;
+}
+
+/* Resolve and load seq at SIM_BASE and call it */
+static sim_status_t call(instr_seq_t *seq, unsigned int argc, const uint32_t *args) {
+  if (!seq_resolve(seq) || !sim_load(&sim, SIM_BASE, seq)) return sim_fault;
+  return sim_call(&sim, SIM_BASE, argc, args);
+}
+
+static bool returns(instr_seq_t *seq, unsigned int argc, const uint32_t *args, uint32_t value) {
+  return call(seq, argc, args) == sim_done && sim.r[0] == value;
+}
+
+static bool cond_holds(cond_t c, uint32_t a, uint32_t b) {
+  switch (c) {
+  case cond_eq: return a == b;
+  case cond_ne: return a != b;
+  case cond_cs: return a >= b;
+  case cond_cc: return a < b;
+  case cond_mi: return (int32_t)(a - b) < 0;
+  case cond_pl: return (int32_t)(a - b) >= 0;
+  case cond_vs: return ((int64_t)(int32_t)a - (int32_t)b) != (int32_t)(a - b);
+  case cond_vc: return ((int64_t)(int32_t)a - (int32_t)b) == (int32_t)(a - b);
+  case cond_hi: return a > b;
+  case cond_ls: return a <= b;
+  case cond_ge: return (int32_t)a >= (int32_t)b;
+  case cond_lt: return (int32_t)a < (int32_t)b;
+  case cond_gt: return (int32_t)a > (int32_t)b;
+  case cond_le: return (int32_t)a <= (int32_t)b;
+  default: return true;
+  }
+}
+
+static int svc_double(sim_t *s, uint32_t imm) {
+  s->r[0] = s->r[0] * 2 + imm;
+  return 1;
+}
+
+int main(int argc, char **argv) {
+  (void) argc;
+  (void) argv;
+
+  instr_seq_t seq;
+  uint32_t args[4];
+
+  test_check(sim_init(&sim, target_m0, 64 * 1024));
+
+  /* constants materialized by load_constant, on both profiles */
+  {
+    const target_t targets[2] = {target_m0, target_m3};
+    bool ok = true;
+    for (unsigned int t = 0; t < 2; t ++) {
+      for (unsigned int i = 0; i < 400; i ++) {
+	uint32_t v = i < 40 ? (1u << (i % 32)) - (i / 32) : rnd() >> (rnd() % 32);
+	if (i % 3 == 0) v = ~v;
+	start(&seq, targets[t]);
+	ok = ok && load_constant(&seq, r3, v, targets[t], (i & 1) ? const_min_cycles : const_min_bytes);
+	emit_opcode(&seq, m0_mov_low(r0, r3));
+	emit_opcode(&seq, m0_bx_any(LR));
+	lit_pool_flush(&seq);
+	ok = ok && returns(&seq, 0, NULL, v);
+	seq_free(&seq);
+      }
+    }
+    test_check(ok);
+  }
+
+  /* a counting loop: sum 1..n */
+  {
+    start(&seq, target_m0);
+    label_t loop = label_new(&seq);
+    emit_opcode(&seq, m0_mov_imm(r1, 0));
+    label_bind(&seq, loop);
+    emit_opcode(&seq, m0_add_low(r1, r1, r0));
+    emit_opcode(&seq, m0_sub_imm8(r0, 1));
+    emit_branch(&seq, cond_ne, loop);
+    emit_opcode(&seq, m0_mov_low(r0, r1));
+    emit_opcode(&seq, m0_bx_any(LR));
+    args[0] = 100;
+    test_check(returns(&seq, 1, args, 5050));
+    test_check(sim.steps == 2 + 100 * 3 + 1);
+
+    /* the same, timed */
+    args[0] = 5000000;
+    clock_t t0 = clock();
+    test_check(returns(&seq, 1, args, (uint32_t)(5000000ull * 5000001ull / 2)));
+    double secs = (double)(clock() - t0) / CLOCKS_PER_SEC;
+    if (secs > 0) printf("host_sim: %.0f M instructions/s\n", sim.steps / secs / 1e6);
+
+    /* the step limit stops a run */
+    args[0] = 1000;
+    sim.limit = 50;
+    test_check(call(&seq, 1, args) == sim_limit);
+    test_check(sim.steps == 50);
+    sim.limit = 0;
+    seq_free(&seq);
+  }
+
+  /* compare and conditional branch, against C */
+  {
+    bool ok = true;
+    for (unsigned int c = cond_eq; c < cond_al; c ++) {
+      start(&seq, target_m0);
+      label_t taken = label_new(&seq);
+      emit_opcode(&seq, m0_mov_imm(r2, 1));
+      emit_opcode(&seq, m0_cmp_any(r0, r1));
+      emit_branch(&seq, (cond_t)c, taken);
+      emit_opcode(&seq, m0_mov_imm(r2, 0));
+      label_bind(&seq, taken);
+      emit_opcode(&seq, m0_mov_low(r0, r2));
+      emit_opcode(&seq, m0_bx_any(LR));
+      for (unsigned int i = 0; i < 200; i ++) {
+	const uint32_t edge[] = {0, 1, 0x7FFFFFFF, 0x80000000, 0xFFFFFFFF};
+	args[0] = i < 25 ? edge[i % 5] : rnd();
+	args[1] = i < 25 ? edge[i / 5] : (i & 1) ? args[0] : rnd();
+	ok = ok && returns(&seq, 2, args, cond_holds((cond_t)c, args[0], args[1]));
+      }
+      seq_free(&seq);
+    }
+    test_check(ok);
+  }
+
+  /* loads, stores, push/pop and a call */
+  {
+    start(&seq, target_m0);
+    label_t fn = label_new(&seq);
+    emit_opcode(&seq, m0_push_lr(0x10));           /* push {r4, lr} */
+    emit_opcode(&seq, m0_ldr_imm5(r1, r0, 1));     /* r1 = [r0 + 4] */
+    emit_opcode(&seq, m0_ldrh_imm5(r2, r0, 1));    /* r2 = [r0 + 2] (half) */
+    emit_opcode(&seq, m0_mov_imm(r3, 3));
+    emit_opcode(&seq, m0_ldrsb_low(r4, r0, r3));   /* r4 = sext [r0 + 3] */
+    emit_opcode(&seq, m0_str_imm5(r4, r0, 2));     /* [r0 + 8] = r4 */
+    emit_opcode(&seq, m0_strb_imm5(r2, r0, 12));   /* [r0 + 12] = r2 (byte) */
+    emit_bl(&seq, fn);
+    emit_opcode(&seq, m0_pop_lr(0x10));            /* pop {r4, pc} */
+    label_bind(&seq, fn);
+    emit_opcode(&seq, m0_add_low(r0, r1, r2));
+    emit_opcode(&seq, m0_bx_any(LR));
+
+    uint32_t data = SIM_BASE + 0x8000;
+    sim_write32(&sim, data, 0x80FF1234);
+    sim_write32(&sim, data + 4, 1000);
+    args[0] = data;
+    sim.r[4] = 0x44;
+    test_check(returns(&seq, 1, args, 1000 + 0x80FF));
+    test_check(sim_read32(&sim, data + 8) == 0xFFFFFF80);
+    test_check(sim_read32(&sim, data + 12) == 0xFF);
+    test_check(sim.r[4] == 0x44 && sim.r[SP] == SIM_BASE + 64 * 1024);
+
+    /* unaligned word access faults on M0 and works on M3 */
+    args[0] = data + 1;
+    test_check(call(&seq, 1, args) == sim_fault && sim.fault_addr == data + 5);
+    sim.target = target_m3;
+    test_check(call(&seq, 1, args) == sim_done);
+    seq_free(&seq);
+  }
+
+  /* Thumb-2 data processing, against C */
+  {
+    bool ok = true;
+    for (unsigned int i = 0; i < 300; i ++) {
+      uint32_t a = rnd();
+      uint32_t b = rnd() >> (i % 32);
+      uint8_t sh = (uint8_t)(1 + i % 31);
+      start(&seq, target_m3);
+      emit_opcode(&seq, m3_add_const32(r2, r0, 0x00FF00FF, false));
+      emit_opcode(&seq, m3_eor_any(r2, r2, r1, sh, imm_shift_ror, false));
+      emit_opcode(&seq, m3_sub_const32(r2, r2, 0x3FC, false));
+      emit_opcode(&seq, m3_bic_any(r2, r2, r1, sh, imm_shift_asr, false));
+      emit_opcode(&seq, m3_orn_const32(r2, r2, 0x55005500, false));
+      emit_opcode(&seq, m3_add_any(r0, r2, r0, sh, imm_shift_lsr, false));
+      emit_opcode(&seq, m0_bx_any(LR));
+      uint32_t x = a + 0x00FF00FF;
+      x ^= (b >> sh) | (b << (32 - sh));
+      x -= 0x3FC;
+      x &= ~(uint32_t)((int32_t)b >> sh);
+      x |= ~0x55005500u;
+      x += a >> sh;
+      args[0] = a;
+      args[1] = b;
+      ok = ok && returns(&seq, 2, args, x);
+      seq_free(&seq);
+    }
+    test_check(ok);
+
+    start(&seq, target_m3);
+    emit_opcode(&seq, m3_movw(r1, 0xBEEF));
+    emit_opcode(&seq, m3_movt(r1, 0xDEAD));
+    emit_opcode(&seq, m3_bfi(r1, r0, 4, 8));
+    emit_opcode(&seq, m3_clz(r2, r0, r0));
+    emit_opcode(&seq, m3_add_any(r0, r1, r2, 0, imm_shift_lsl, false));
+    emit_opcode(&seq, m0_bx_any(LR));
+    args[0] = 0x1234;
+    test_check(returns(&seq, 1, args, 0xDEADB34F + 19));
+
+    /* not on M0 */
+    sim.target = target_m0;
+    test_check(call(&seq, 1, args) == sim_undefined && sim.r[PC] == SIM_BASE);
+    seq_free(&seq);
+  }
+
+  /* an IT block: ITE EQ, MOV (no flags inside IT), MOV */
+  {
+    start(&seq, target_m3);
+    emit_opcode(&seq, m0_cmp_imm8(r0, 0));
+    emit_opcode(&seq, (thumb_opcode_t){thumb16, {.thumb16 = 0xBF0C}});
+    emit_opcode(&seq, m0_mov_imm(r0, 1));
+    emit_opcode(&seq, m0_mov_imm(r0, 2));
+    emit_opcode(&seq, m0_bx_any(LR));
+    args[0] = 0;
+    test_check(returns(&seq, 1, args, 1) && sim.z);
+    args[0] = 7;
+    test_check(returns(&seq, 1, args, 2) && !sim.z);
+    seq_free(&seq);
+  }
+
+  /* SVC through the hook, BKPT stops */
+  {
+    start(&seq, target_m0);
+    emit_opcode(&seq, m0_svc_imm8(3));
+    emit_opcode(&seq, m0_bkpt_imm8(0));
+    sim.svc = svc_double;
+    args[0] = 20;
+    test_check(call(&seq, 1, args) == sim_bkpt && sim.r[0] == 43);
+    test_check(sim.r[PC] == SIM_BASE + 2);
+    sim.svc = NULL;
+    test_check(call(&seq, 1, args) == sim_svc && sim.r[PC] == SIM_BASE + 2);
+    seq_free(&seq);
+  }
+
+  /* patched code is picked up, also when the code patches itself */
+  {
+    start(&seq, target_m0);
+    emit_opcode(&seq, m0_mov_imm(r0, 1));
+    emit_opcode(&seq, m0_bx_any(LR));
+    test_check(returns(&seq, 0, NULL, 1));
+    uint16_t mov2 = m0_mov_imm(r0, 2).opcode.thumb16;
+    uint8_t bytes[2] = {(uint8_t)mov2, (uint8_t)(mov2 >> 8)};
+    sim_write(&sim, SIM_BASE, bytes, 2);
+    test_check(sim_call(&sim, SIM_BASE, 0, NULL) == sim_done && sim.r[0] == 2);
+
+    /* r1 = address, r2 = new instruction: strh r2, [r1]; adds r1, #1; bx r1 */
+    uint32_t fn = SIM_BASE + 0x100;
+    seq_free(&seq);
+    start(&seq, target_m0);
+    emit_opcode(&seq, m0_strh_imm5(r2, r1, 0));
+    emit_opcode(&seq, m0_add_imm8(r1, 1));
+    emit_opcode(&seq, m0_bx_any(r1));
+    sim_load(&sim, SIM_BASE, &seq);
+    args[0] = 0;
+    args[1] = fn;
+    uint16_t bx = m0_bx_any(LR).opcode.thumb16;
+    uint8_t ret[2] = {(uint8_t)bx, (uint8_t)(bx >> 8)};
+    sim_write(&sim, fn + 2, ret, 2);
+    args[2] = m0_mov_imm(r0, 6).opcode.thumb16;
+    test_check(sim_call(&sim, SIM_BASE, 3, args) == sim_done && sim.r[0] == 6);
+    args[2] = m0_mov_imm(r0, 7).opcode.thumb16;
+    test_check(sim_call(&sim, SIM_BASE, 3, args) == sim_done && sim.r[0] == 7);
+    seq_free(&seq);
+  }
+
+  sim_free(&sim);
+  return test_host_result(testname);
+}
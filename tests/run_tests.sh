@@ -7,8 +7,25 @@ make
 
 echo "RUNNING EXECUTABLES:"
 
+success_count=0
+fail_count=0
+
 for exe in *.exe; do
     ./$exe
+    result=$?
+
+    case $exe in
+	host_*)
+	    if [ $result -eq 0 ]
+	    then
+		success_count=$((success_count+1))
+		echo $exe SUCCESS
+	    else
+		fail_count=$((fail_count+1))
+		echo $exe FAILED
+	    fi
+	    ;;
+    esac
 done
 
 echo "STARTING OPENOCD IN BACKGROUND:"
@@ -17,8 +34,6 @@ PID=$!
 
 echo "PERFORMING TESTS:"
 
-success_count=0
-fail_count=0
 result=0
 
 for expect in *.expect; do
@@ -44,9 +44,7 @@ int main(int argc, char **argv) {
   
   uint16_t instrs[13];
   instr_seq_t seq;
-  seq.size = 13;
-  seq.pos  = 0;
-  seq.mc = instrs;
+  seq_init(&seq, instrs, 13);
   
   emit_opcode(&seq, m0_mov_imm(r0, 2));
   test_step();
@@ -44,9 +44,7 @@ int main(int argc, char **argv) {
   
   uint16_t instrs[24];
   instr_seq_t seq;
-  seq.size = 24;
-  seq.pos  = 0;
-  seq.mc = instrs;
+  seq_init(&seq, instrs, 24);
   
   emit_opcode(&seq, m3_adc_imm(r1, r2, 0xFE, false));
   emit_opcode(&seq, m3_adc_any(r0, r1, r2, 0x3, imm_shift_lsl, true));